@@ -4,15 +4,35 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <string>
 #include "shader.h"
 #include "obj_loader.h"
+#include "obj_parser.h"
+#include "mesh_simplifier.h"
 #include "camera.h"
 #include "terrain.h"
 #include "player.h"
-#include "tree.h"
+#include "prop.h"
+#include "grass.h"
 #include "water.h"
 #include "stb_image.h"
 #include "sun.h"
+#include "shadow_pass.h"
+#include "frame_data.h"
+#include "gl_caps.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "render_graph.h"
+#include "stream_buffer.h"
+#include "frustum.h"
+#include "gpu_timer.h"
+#include "memory_stats.h"
+#include "asset_loader.h"
+#include "asset_pack.h"
+#include "texture_cook.h"
 
 const unsigned int WIDTH = 1400;
 const unsigned int HEIGHT = 800;
@@ -21,10 +41,31 @@ const int WORLD_SIZE = 500;
 
 bool firstMouse = true;
 
-GLuint shadowFBO, shadowMap;
+// foliage debug toggles: F1 depth prepass, F2 overdraw view
+bool foliagePrepass = true;
+bool showOverdraw = false;
+
+// --keep-cpu-meshes keeps terrain vertices in memory after upload, for debugging
+bool keepCpuMeshes = false;
+// --no-texture-compression uploads textures uncompressed and skips .bctex cooking
+bool textureCompression = true;
+// --texture-budget <MB> caps the mip levels streamed textures keep resident (0 = no cap)
+size_t textureMemoryBudget = 64 * 1024 * 1024;
+// scene shader variants, compiled in as defines: --no-shadows, --shadow-pcf <radius>
+// (0 single tap, 1 3x3, 2 5x5) and --fog-in-shader, which fogs each fragment and skips
+// the post-processing pass
+bool shadowsEnabled = true;
+int shadowPcfRadius = 1;
+bool fogInShader = false;
+// --gpu-culling culls terrain regions in a compute pass instead of on the CPU (GL 4.3)
+bool gpuCulling = false;
+
 const GLuint SHADOW_WIDTH = 4096, SHADOW_HEIGHT = 4096;
+const float FOG_DENSITY = 0.002f;
 
-glm::mat4 lightSpaceMatrix;
+// texel bytes staged for upload per frame while assets stream in
+const size_t TEXTURE_UPLOAD_BUDGET = 16 * 1024 * 1024;
+const char* ASSET_PACK_PATH = "assets.pack";
 
 struct MouseContext {
     Camera* camera;
@@ -99,40 +140,30 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 
 
 
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
-    MouseContext* ctx = reinterpret_cast<MouseContext*>(glfwGetWindowUserPointer(window));
-    if (!ctx || !ctx->camera) return;
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
 
-    ctx->camera->ProcessMouseScroll(float(yoffset));
+    if (key == GLFW_KEY_F1) {
+        foliagePrepass = !foliagePrepass;
+        std::cout << "Foliage depth prepass: " << (foliagePrepass ? "on" : "off") << "\n";
+    }
+    if (key == GLFW_KEY_F2) {
+        showOverdraw = !showOverdraw;
+        std::cout << "Foliage overdraw view: " << (showOverdraw ? "on" : "off") << "\n";
+    }
 }
 
 
-GLuint postFBO, postColorTex, postDepthTex;
-
-void SetupPostProcessingFrameBuffer() {
-    glGenFramebuffers(1, &postFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, postFBO);
-
-    // Color attachment
-    glGenTextures(1, &postColorTex);
-    glBindTexture(GL_TEXTURE_2D, postColorTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, WIDTH, HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, postColorTex, 0);
 
-    // Depth attachment
-    glGenTextures(1, &postDepthTex);
-    glBindTexture(GL_TEXTURE_2D, postDepthTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, WIDTH, HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, postDepthTex, 0);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cerr << "Post-processing framebuffer not complete!" << std::endl;
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+    MouseContext* ctx = reinterpret_cast<MouseContext*>(glfwGetWindowUserPointer(window));
+    if (!ctx || !ctx->camera) return;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ctx->camera->ProcessMouseScroll(float(yoffset));
 }
 
+
 GLuint quadVAO, quadVBO;
 void SetupFullscreenQuad() {
     float quadVertices[] = {
@@ -146,7 +177,7 @@ void SetupFullscreenQuad() {
     };
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    BindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
@@ -154,63 +185,76 @@ void SetupFullscreenQuad() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 }
-void RenderFogPostProcessing(GLuint fogShader, GLuint postColorTex, GLuint postDepthTex,
-    glm::vec3 fogColor, glm::vec3 cameraPos,
-    const glm::mat4& projection, const glm::mat4& view) {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, WIDTH, HEIGHT);
+// reconstructs world positions from depth with the FrameData camera and fogs them with its fog color
+void RenderFogPostProcessing(const ShaderProgram& fogShader, GLuint sceneColor, GLuint sceneDepth, glm::vec3 fogColor) {
+    // the window is multisampled, so the scene cannot be blitted across; until the program
+    // links the screen is all fog
+    if (!fogShader.IsReady()) {
+        glClearColor(fogColor.r, fogColor.g, fogColor.b, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        return;
+    }
 
-    glDisable(GL_DEPTH_TEST);
+    SetEnabled(GL_DEPTH_TEST, false);
     glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(fogShader);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, postColorTex);
-    glUniform1i(glGetUniformLocation(fogShader, "scene"), 0);
+    fogShader.Use();
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, postDepthTex);
-    glUniform1i(glGetUniformLocation(fogShader, "depthMap"), 1);
+    // scene on unit 0 and depthMap on unit 1, set when the program is loaded
+    BindTexture(0, GL_TEXTURE_2D, sceneColor);
+    BindTexture(1, GL_TEXTURE_2D, sceneDepth);
 
-    glUniform3fv(glGetUniformLocation(fogShader, "fogColor"), 1, glm::value_ptr(fogColor));
-    glUniform3fv(glGetUniformLocation(fogShader, "camPos"), 1, glm::value_ptr(cameraPos));
-
-    glm::mat4 invProj = glm::inverse(projection);
-    glm::mat4 invView = glm::inverse(view);
-
-    glUniformMatrix4fv(glGetUniformLocation(fogShader, "invProj"), 1, GL_FALSE, glm::value_ptr(invProj));
-    glUniformMatrix4fv(glGetUniformLocation(fogShader, "invView"), 1, GL_FALSE, glm::value_ptr(invView));
-
-    glBindVertexArray(quadVAO);
+    BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
-    glEnable(GL_DEPTH_TEST);
+    SetEnabled(GL_DEPTH_TEST, true);
 }
 
-void SetupShadowFramebuffer(GLuint& shadowFBO, GLuint& shadowMap, GLuint width, GLuint height) {
-    glGenFramebuffers(1, &shadowFBO);
-    glGenTextures(1, &shadowMap);
-
-    glBindTexture(GL_TEXTURE_2D, shadowMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
+int main(int argc, char** argv) {
+    // offline mode: time the OBJ parsers without opening a window
+    if (argc > 2 && std::string(argv[1]) == "--bench-obj") {
+        RunObjParseBenchmark(argv[2]);
+        return 0;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--bench-simplify") {
+        RunSimplifyBenchmark(argv[2]);
+        return 0;
+    }
+    // offline mode: cook loose assets into the archive read below
+    if (argc > 1 && std::string(argv[1]) == "--pack") {
+        return BuildAssetPack(argc > 2 ? argv[2] : ASSET_PACK_PATH, { "textures", "objs", "shaders" }) ? 0 : 1;
+    }
+    // offline modes below that need a GL context run once it exists
+    std::string cookFormat, benchTexture;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--keep-cpu-meshes")
+            keepCpuMeshes = true;
+        else if (arg == "--no-texture-compression")
+            textureCompression = false;
+        else if (arg == "--no-shadows")
+            shadowsEnabled = false;
+        else if (arg == "--shadow-pcf" && i + 1 < argc)
+            shadowPcfRadius = glm::clamp(std::atoi(argv[++i]), 0, 2);
+        else if (arg == "--fog-in-shader")
+            fogInShader = true;
+        else if (arg == "--gpu-culling")
+            gpuCulling = true;
+        else if (arg == "--texture-budget" && i + 1 < argc)
+            textureMemoryBudget = static_cast<size_t>(std::atof(argv[++i]) * 1024 * 1024);
+        else if (arg == "--cook-textures")
+            cookFormat = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "bc7";
+        else if (arg == "--bench-textures" && i + 1 < argc)
+            benchTexture = argv[++i];
+    }
 
-int main() {
     std::srand(static_cast<unsigned int>(std::time(0)));
 
+    // loaders take anything the archive has from its mapping, loose files otherwise
+    if (GetAssetPack().Open(ASSET_PACK_PATH)) {
+        std::cout << "Asset pack: " << ASSET_PACK_PATH << " mapped, " << GetAssetPack().GetEntryCount() << " entries, "
+            << GetAssetPack().GetSize() / (1024.0 * 1024.0) << " MB\n";
+    }
+
     if (!glfwInit()) return -1;
 
     glfwWindowHint(GLFW_SAMPLES, 4);
@@ -219,15 +263,45 @@ int main() {
 
     glfwMakeContextCurrent(window);
     if (gl3wInit()) return -1;
+    InitGLCaps();
+
+    if (!cookFormat.empty() || !benchTexture.empty()) {
+        if (!cookFormat.empty())
+            CookTextures("textures", cookFormat == "bc1" ? BlockFormat::BC1 : BlockFormat::BC7);
+        if (!benchTexture.empty())
+            RunTextureBandwidthBenchmark(benchTexture);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
 
 	// OpenGL options
     glEnable(GL_MULTISAMPLE);
-    glEnable(GL_DEPTH_TEST);    
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    //init shadow frame buffer
-	SetupShadowFramebuffer(shadowFBO, shadowMap, SHADOW_WIDTH, SHADOW_HEIGHT);
+    SetEnabled(GL_DEPTH_TEST, true);
+    SetEnabled(GL_BLEND, true);
+    SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // decode and parse on worker threads, upload from here a slice per frame
+    AssetLoader assets;
+    assets.Init();
+    assets.SetBlockCompression(textureCompression);
+    assets.SetTextureMemoryBudget(textureMemoryBudget);
+
+    // scene-wide shader variants; every program below is built with them
+    std::string sceneDefines = "#define PCF_RADIUS " + std::to_string(shadowPcfRadius) + "\n";
+    if (shadowsEnabled)
+        sceneDefines += "#define SHADOWS\n";
+    if (fogInShader)
+        sceneDefines += "#define FOG_IN_SHADER\n";
+    SetGlobalShaderDefines(sceneDefines);
+
+    // per-frame uniforms shared by every scene shader
+    FrameDataBuffer frameData;
+    frameData.Init();
+
+    //init shadow caster pass
+    ShadowPass shadowPass;
+    shadowPass.Init();
 
     // init camera
     Camera camera;
@@ -235,20 +309,44 @@ int main() {
 
     //init terrain
     Terrain terrain;
-    terrain.Init(WORLD_SIZE, WORLD_SIZE);
+    terrain.SetGpuCulling(gpuCulling);
+    terrain.Init(WORLD_SIZE, WORLD_SIZE, assets, keepCpuMeshes);
+    terrain.RegisterShadowCasters(shadowPass);
+
+    //init ground cover
+    Grass grass;
+    grass.Init(WORLD_SIZE, terrain);
 
     //init water
 	Water water = Water();
     water.Init(WORLD_SIZE, 0.0f);
 
-    //init terrain
-    TreeManager treeManager;
-    treeManager.Generate(NUM_TREES, WORLD_SIZE, terrain);
+    //init props
+    PropRegistry props;
+    PropType tree;
+    tree.name = "tree";
+    tree.meshPath = "objs/Tree.obj";
+    tree.parts = {
+        { "Trank_bark", "objs/bark_0021.jpg", glm::vec4(0.30f, 0.22f, 0.15f, 1.0f) },
+        { "polySurface1SG1", "objs/DB2X2_L01.png", glm::vec4(0.0f), true }     // leaves stay hidden until loaded
+    };
+    tree.density.count = NUM_TREES;
+    tree.density.minHeight = -1.5f;
+    tree.density.minScale = 6.0f;
+    tree.density.maxScale = 8.5f;
+    tree.density.sink = 0.5f;
+    props.Register(tree);
+    props.Scatter(WORLD_SIZE, terrain);
 
     //init player
     Player player;
     player.init(glm::vec3(WORLD_SIZE / 2, 0.0f, WORLD_SIZE / 2));
-    player.LoadModel("objs/human.obj");
+    assets.Submit("objs/human.obj",
+        [&player] { player.LoadModel("objs/human.obj"); },
+        [&player, &shadowPass] {
+            player.SetupOpenGL();
+            player.RegisterShadowCaster(shadowPass);
+        });
 
     //init sun
     Sun sun;
@@ -260,37 +358,65 @@ int main() {
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     // init shaders
-    GLuint tileShader = CompileShader("shaders/tile.vert", "shaders/tile.frag");
-    GLuint playerShader = CompileShader("shaders/player.vert", "shaders/player.frag");
-    GLuint treeShader = CompileShader("shaders/tree.vert", "shaders/tree.frag");
-    GLuint shadowShader = CompileShader("shaders/shadow_depth.vert", "shaders/shadow_depth.frag");
-    GLuint fogShader = CompileShader("shaders/fog_post.vert", "shaders/fog_post.frag");
-
-    // init trees
-    std::vector<MeshSegment> segments = LoadMeshByMaterial("objs/Tree.obj");
-    std::vector<float> trunkVerts;
-    std::vector<float> leafVerts;
-    for (const auto& seg : segments) {
-        if (seg.materialName == "Trank_bark") {
-            trunkVerts = seg.vertices;
-        }
-        else if (seg.materialName == "polySurface1SG1") {
-            leafVerts = seg.vertices;
-        }
-        else {
-            std::cerr << "Unknown material: " << seg.materialName << "\n";
-        }
+    ShaderProgram playerShader, fogShader;
+    // tree variants: color by [overdraw view][alpha test], depth prepass by [alpha test]
+    ShaderProgram treeShaders[2][2], treeDepthShaders[2];
+    playerShader.Load("shaders/player.vert", "shaders/player.frag");
+    const char* alphaTestDefines[2] = { "", "#define ALPHA_TEST\n" };
+    for (int alphaTest = 0; alphaTest < 2; alphaTest++) {
+        std::string defines = alphaTestDefines[alphaTest];
+        treeShaders[0][alphaTest].Load("shaders/tree.vert", "shaders/tree.frag", defines.c_str());
+        treeShaders[1][alphaTest].Load("shaders/tree.vert", "shaders/tree.frag", (defines + "#define SHOW_OVERDRAW\n").c_str());
+        treeDepthShaders[alphaTest].Load("shaders/tree.vert", "shaders/tree_depth.frag", defines.c_str());
+    }
+    if (!fogInShader)
+        fogShader.Load("shaders/fog_post.vert", "shaders/fog_post.frag");
+
+    // sampler units never change, so they are set once here instead of every frame
+    playerShader.Use();
+    playerShader.SetInt(UniformId("shadowMap"), SHADOW_MAP_UNIT);
+    for (const ShaderProgram* shader : { &treeShaders[0][0], &treeShaders[0][1], &treeShaders[1][0], &treeShaders[1][1],
+        &treeDepthShaders[0], &treeDepthShaders[1] }) {
+        shader->Use();
+        shader->SetInt(UniformId("treeTextures"), 0);
+        shader->SetInt(UniformId("shadowMap"), SHADOW_MAP_UNIT);
     }
-    treeManager.SetMeshes(trunkVerts, leafVerts);
-    treeManager.LoadTextures("objs/bark_0021.jpg", "objs/DB2X2_L01.png");
-    treeManager.SetupOpenGL();
+    fogShader.Use();
+    fogShader.SetInt(UniformId("scene"), 0);
+    fogShader.SetInt(UniformId("depthMap"), 1);
+
+    // init prop meshes and textures
+    assets.Submit(tree.meshPath,
+        [&props] { props.LoadMeshes(); },
+        [&props, &assets, &shadowPass] {
+            props.SetupOpenGL(assets);
+            props.RegisterShadowCasters(shadowPass);
+        });
 
 	//init prost processing
-    SetupPostProcessingFrameBuffer();
     SetupFullscreenQuad();
 
+    // counts shaded foliage fragments for comparing the prepass on and off
+    GpuTimer foliageFragments;
+    foliageFragments.Init(GL_SAMPLES_PASSED);
+
+    // passes and their targets are declared again every frame; textures come from its pool
+    RenderGraph renderGraph;
+
+    // the scene is queued, sorted and drawn pass by pass; the prepass only writes depth
+    RenderQueue renderQueue;
+    PassState depthOnly;
+    depthOnly.colorWrite = false;
+    renderQueue.SetPassState(RenderPass::FoliageDepth, depthOnly);
+    int frameCount = 0;
+    bool shadersCompiling = true;
+    // count state calls from the first frame on, not the ones made while loading
+    ResetGLStateStats();
+    ResetStreamStats();
+
 	//init delta time
     float lastFrameTime = glfwGetTime();
 
@@ -302,42 +428,42 @@ int main() {
         
         glfwPollEvents();
 
+        // the window may have been resized; render targets follow it in the render graph
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (framebufferWidth == 0 || framebufferHeight == 0)
+            continue;   // minimized
+
+        // pick up linked programs; a pass whose program is still compiling skips itself
+        if (shadersCompiling && PollShaderPrograms() == 0) {
+            shadersCompiling = false;
+            const ShaderStats& shaderStats = GetShaderStats();
+            std::cout << "Shaders: " << shaderStats.compiled << " compiled, " << shaderStats.fromBinary << " from cached binaries, "
+                << shaderStats.shared << " shared, " << shaderStats.failed << " failed; " << shaderStats.issueMilliseconds
+                << " ms issuing, " << shaderStats.finishMilliseconds << " ms finishing, ready after " << frameCount << " frames\n";
+        }
+
+        // finish loaded assets and stream texels; report memory once everything is in
+        bool loading = !assets.IsIdle();
+        assets.Update(TEXTURE_UPLOAD_BUDGET);
+        if (loading && assets.IsIdle()) {
+            // heap and RSS after loading; driver allocations (shader compiles etc.) count too
+            PrintMemoryReport("Startup memory");
+        }
+
         // update player
         player.Update(dt, terrain);
 
+        // recycle grass patches around the player
+        grass.Update(player.GetPosition());
+
         // update camera
         camera.SetTarget(player.GetPosition() + glm::vec3(0.0f, 2.6f, 0.0f));
 		camera.UpdateVectors();
 
 		//update sun & related variables
 		sun.Update(dt, player.GetPosition());
-        glm::vec3 lightDir = sun.GetDirection();
-        glm::vec3 lightColor = sun.GetColor();
         float sunElevation = sun.GetElevation();
-        glm::mat4 lightSpaceMatrix = sun.GetLightSpaceMatrix();
-
-		// update shadow map
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        glUseProgram(shadowShader);
-        glUniformMatrix4fv(glGetUniformLocation(shadowShader, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
-        treeManager.RenderShadow(shadowShader);
-        player.RenderShadow(shadowShader, lightSpaceMatrix);
-
-		// change to post processing framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, postFBO);
-        glViewport(0, 0, WIDTH, HEIGHT);  
-
-        // render sky sky
-        float t = glm::clamp(sunElevation, -1.0f, 1.0f);
-        float nightAmount = glm::clamp(glm::smoothstep(-0.9f, 0.0f, t), 0.0f, 1.0f);
-        glm::vec3 nightColor = glm::vec3(0.05f, 0.05f, 0.1f);
-        glm::vec3 dayColor = glm::vec3(0.5f, 0.7f, 1.0f);
-        glm::vec3 skyColor;
-        skyColor = glm::mix(dayColor, nightColor, nightAmount);
-        glClearColor(skyColor.r, skyColor.g, skyColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// update projection and view matrices
         float nearPlane = 0.1f;
@@ -345,34 +471,188 @@ int main() {
 		glm::vec3 cameraPos = camera.GetPosition();
 		glm::vec3 cameraTarget = camera.GetTarget();
 		glm::vec3 cameraUp = camera.GetUp();
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / HEIGHT, nearPlane, farPlane);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)framebufferWidth / framebufferHeight, nearPlane, farPlane);
         glm::mat4 view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
 
-        // render floor
-        terrain.Render(projection, view, cameraPos, lightDir, lightColor, lightSpaceMatrix, shadowMap, sunElevation);
-
-        // render player
-        player.Render(playerShader, projection, view, lightDir, lightColor, cameraPos, lightSpaceMatrix, shadowMap, sunElevation);
-
-
-        // render trees
-        treeManager.Render(projection, view, treeShader, lightDir, lightColor, cameraPos, lightSpaceMatrix, shadowMap, sunElevation);
-
-        // render water
-        water.Render(projection, view, sunElevation);
-
-		// render post processing
+        // sky and fog colors follow the sun
+        float t = glm::clamp(sunElevation, -1.0f, 1.0f);
+        float nightAmount = glm::clamp(glm::smoothstep(-0.9f, 0.0f, t), 0.0f, 1.0f);
+        glm::vec3 nightColor = glm::vec3(0.05f, 0.05f, 0.1f);
+        glm::vec3 dayColor = glm::vec3(0.5f, 0.7f, 1.0f);
+        glm::vec3 skyColor;
+        skyColor = glm::mix(dayColor, nightColor, nightAmount);
         glm::vec3 fogDay = glm::vec3(0.6f, 0.7f, 0.8f);
         glm::vec3 fogNight = glm::vec3(0.05f, 0.06f, 0.08f);
         glm::vec3 fogColor = glm::mix(fogDay, fogNight, nightAmount);
-        RenderFogPostProcessing(fogShader, postColorTex, postDepthTex, fogColor, cameraPos, projection, view);
+
+        // everything the scene shaders share goes up in one buffer update
+        FrameData frame = {};
+        frame.projection = projection;
+        frame.view = view;
+        frame.viewProjection = projection * view;
+        frame.inverseProjection = glm::inverse(projection);
+        frame.inverseView = glm::inverse(view);
+        frame.lightSpaceMatrix = sun.GetLightSpaceMatrix();
+        frame.viewPos = cameraPos;
+        frame.sunElevation = sunElevation;
+        frame.lightDir = sun.GetDirection();
+        frame.time = currentFrameTime;
+        frame.lightColor = sun.GetColor();
+        frame.fogDensity = FOG_DENSITY;
+        frame.fogColor = fogColor;
+        frameData.Update(frame);
+
+        // shadow map, then the scene into the window or into targets the fog pass reads
+        renderGraph.BeginFrame(framebufferWidth, framebufferHeight);
+        RenderTargetDesc shadowDesc;
+        shadowDesc.width = SHADOW_WIDTH;
+        shadowDesc.height = SHADOW_HEIGHT;
+        shadowDesc.internalFormat = GL_DEPTH_COMPONENT;
+        shadowDesc.filter = GL_NEAREST;
+        shadowDesc.wrap = GL_CLAMP_TO_BORDER;
+        RenderResource shadowMap = renderGraph.CreateTarget("shadowMap", shadowDesc);
+        RenderTargetDesc colorDesc;
+        colorDesc.internalFormat = GL_RGB;
+        RenderResource sceneColor = renderGraph.CreateTarget("sceneColor", colorDesc);
+        RenderTargetDesc depthDesc;
+        depthDesc.internalFormat = GL_DEPTH_COMPONENT;
+        depthDesc.filter = GL_NEAREST;
+        RenderResource sceneDepth = renderGraph.CreateTarget("sceneDepth", depthDesc);
+
+        // culled when nothing samples the map
+        int shadowPassId = renderGraph.AddPass("shadow", [&] {
+            shadowPass.BeginFrame(sun.GetLightView(), sun.GetLightProjection());
+            terrain.SubmitShadowCasters(shadowPass);
+            props.SubmitShadowCasters(shadowPass);
+            player.SubmitShadowCaster(shadowPass);
+            shadowPass.Render();
+        });
+        renderGraph.Write(shadowPassId, shadowMap);
+
+        int scenePass = renderGraph.AddPass("scene", [&] {
+            // bound once for every pass that samples it; nothing else uses this unit until the fog pass
+            if (shadowsEnabled)
+                BindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_2D, renderGraph.GetTexture(shadowMap));
+
+            // render sky sky; the post pass fogs it at the far plane, so in-shader fog does the same here
+            if (fogInShader)
+                skyColor = glm::mix(skyColor, fogColor, 1.0f - std::exp(-farPlane * FOG_DENSITY));
+            glClearColor(skyColor.r, skyColor.g, skyColor.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // pixels covered by one world unit at distance one, for picking levels of detail
+            float lodScale = projection[1][1] * framebufferHeight * 0.5f;
+            Frustum frustum;
+            frustum.Extract(frame.viewProjection);
+            props.UpdateDraws(cameraPos, frustum, lodScale);
+            terrain.RequestTextureDetail(assets, cameraPos, lodScale);
+
+            // queue floor, ground cover, player, props and water
+            renderQueue.Begin(cameraPos, farPlane);
+            terrain.Submit(renderQueue, frustum);
+            grass.Submit(renderQueue);
+            player.Submit(renderQueue, playerShader, lodScale);
+
+            // props optionally lay down depth first so leaves are shaded once; after the prepass
+            // nothing needs discard, otherwise only the leaves use the alpha-tested variant
+            const ShaderProgram* propShaders = treeShaders[showOverdraw ? 1 : 0];
+            const ShaderProgram* leafShader = &propShaders[1];
+            PassState foliageState;
+            if (foliagePrepass && treeDepthShaders[0].IsReady() && treeDepthShaders[1].IsReady()) {
+                props.Submit(renderQueue, RenderPass::FoliageDepth, treeDepthShaders[0], treeDepthShaders[1]);
+                foliageState.depthFunc = GL_EQUAL;
+                foliageState.depthWrite = false;
+                leafShader = &propShaders[0];
+            }
+            if (showOverdraw) {
+                foliageState.blendSource = GL_ONE;
+                foliageState.blendDestination = GL_ONE;
+            }
+            renderQueue.SetPassState(RenderPass::Foliage, foliageState);
+            props.Submit(renderQueue, RenderPass::Foliage, propShaders[0], *leafShader);
+
+            water.Submit(renderQueue);
+            renderQueue.Sort();
+
+            renderQueue.Submit(RenderPass::Opaque);
+            renderQueue.Submit(RenderPass::FoliageDepth);
+            foliageFragments.Begin();
+            renderQueue.Submit(RenderPass::Foliage);
+            foliageFragments.End();
+            // water keeps writing depth, the fog pass reads it
+            renderQueue.Submit(RenderPass::Transparent);
+        });
+        if (shadowsEnabled)
+            renderGraph.Read(scenePass, shadowMap);
+
+        // with fog in the shaders the scene goes straight to the window
+        if (fogInShader) {
+            renderGraph.Write(scenePass, renderGraph.GetBackbuffer());
+        }
+        else {
+            renderGraph.Write(scenePass, sceneColor);
+            renderGraph.Write(scenePass, sceneDepth);
+            int fogPass = renderGraph.AddPass("fog", [&] {
+                RenderFogPostProcessing(fogShader, renderGraph.GetTexture(sceneColor), renderGraph.GetTexture(sceneDepth), fogColor);
+            });
+            renderGraph.Read(fogPass, sceneColor);
+            renderGraph.Read(fogPass, sceneDepth);
+            renderGraph.Write(fogPass, renderGraph.GetBackbuffer());
+        }
+        renderGraph.Execute();
+
+        if (++frameCount % 300 == 0) {
+            std::cout << "Foliage: " << static_cast<long long>(foliageFragments.GetAverage()) << " shaded fragments/frame"
+                << (foliagePrepass ? " (depth prepass)" : "") << "\n";
+            foliageFragments.Reset();
+
+            const GLStateStats& stateStats = GetGLStateStats();
+            std::cout << "GL state: " << stateStats.issued / 300 << " calls/frame issued, "
+                << stateStats.filtered / 300 << " filtered as redundant\n";
+            ResetGLStateStats();
+
+            // any wait means the GPU is more than two writes of a buffer behind
+            const StreamStats& streamStats = GetStreamStats();
+            std::cout << "Stream buffers: " << streamStats.maps / 300.0 << " maps/frame, " << streamStats.waits
+                << " fence waits (" << streamStats.waitMilliseconds << " ms), " << streamStats.reallocations << " reallocations\n";
+            ResetStreamStats();
+
+            std::cout << "Scene: " << renderQueue.GetDrawCount() << " draw calls, terrain regions in view: ";
+            if (terrain.GetVisibleRegionCount() < 0)
+                std::cout << "culled on the GPU";
+            else
+                std::cout << terrain.GetVisibleRegionCount() << " of " << terrain.GetRegionCount();
+            std::cout << ", prop instances in view: " << props.GetVisibleInstanceCount() << " of " << props.GetInstanceCount() << "\n";
+        }
 
         glfwSwapBuffers(window);
-		
+        if (frameCount == 1)
+            std::cout << "First frame after " << glfwGetTime() * 1000.0 << " ms\n";
     }
 
+    assets.Cleanup();
+    GetAssetPack().Close();
+
+    // GL objects go while the context is still current; some own mapped buffers and fences
+    water.Cleanup();
+    terrain.Cleanup();
+    props.Cleanup();
+    foliageFragments.Cleanup();
+    shadowPass.Cleanup();
+    renderGraph.Cleanup();
+    frameData.Cleanup();
+    grass.Cleanup();
+    playerShader.Cleanup();
+    fogShader.Cleanup();
+    for (int alphaTest = 0; alphaTest < 2; alphaTest++) {
+        treeShaders[0][alphaTest].Cleanup();
+        treeShaders[1][alphaTest].Cleanup();
+        treeDepthShaders[alphaTest].Cleanup();
+    }
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+
     glfwDestroyWindow(window);
     glfwTerminate();
-    water.Cleanup();
     return 0;
 }
\ No newline at end of file
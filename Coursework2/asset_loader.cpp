@@ -0,0 +1,780 @@
+#include "asset_loader.h"
+#include "asset_pack.h"
+#include "texture.h"
+#include "texture_cook.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+void PlaceholderTexels(const glm::vec4& color, unsigned char* out) {
+    for (int c = 0; c < 4; c++)
+        out[c] = static_cast<unsigned char>(glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// levels no larger than this are uploaded with the texture and never dropped
+const int STREAM_TAIL_SIZE = 256;
+// how long a level nobody asks for stays resident when the budget does not need it back
+const double STREAM_DROP_DELAY_MS = 2000.0;
+
+// reads one byte per page, so a mapping is paged in on a worker rather than during the GL
+// thread's copy into the unpack buffer
+void Prefetch(const unsigned char* data, size_t size) {
+    volatile unsigned char sink = 0;
+    for (size_t i = 0; i < size; i += 4096)
+        sink = sink + data[i];
+}
+
+double ToMB(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+void SetSamplerState(GLenum target) {
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+}
+
+void AssetLoader::Init(int threadCount) {
+    start = std::chrono::steady_clock::now();
+
+    // every image is flipped, so the global flag is set once before any worker decodes
+    stbi_set_flip_vertically_on_load(true);
+
+    // leave a core for the GL thread when there is one to spare
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    int count = threadCount > 0 ? threadCount : static_cast<int>(std::max(1u, hardwareThreads - 1));
+    for (int i = 0; i < count; i++)
+        workers.emplace_back(&AssetLoader::WorkerLoop, this);
+}
+
+double AssetLoader::Now() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t AssetLoader::AddEntry(const std::string& name) {
+    TimelineEntry entry;
+    entry.name = name;
+    entry.queued = Now();
+    timeline.push_back(entry);
+    return timeline.size() - 1;
+}
+
+void AssetLoader::Submit(const std::string& name, std::function<void()> work, std::function<void()> finish) {
+    Enqueue(queue, name, std::move(work), std::move(finish));
+}
+
+size_t AssetLoader::Enqueue(std::deque<Job>& target, const std::string& name, std::function<void()> work, std::function<void()> finish) {
+    size_t entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entry = AddEntry(name);
+        // texture jobs hand over to the upload queue, which marks them ready
+        target.push_back({ entry, &target == &textureQueue, std::move(work), std::move(finish) });
+        outstanding++;
+    }
+    wake.notify_one();
+    return entry;
+}
+
+void AssetLoader::MarkReady(size_t entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timeline[entry].ready = Now();
+    outstanding--;
+}
+
+void AssetLoader::WorkerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty() || !textureQueue.empty() || !streamQueue.empty(); });
+            if (stopping)
+                return;
+            std::deque<Job>& source = !queue.empty() ? queue : !textureQueue.empty() ? textureQueue : streamQueue;
+            job = std::move(source.front());
+            source.pop_front();
+            if (job.entry != NO_ENTRY)
+                timeline[job.entry].started = Now();
+        }
+
+        job.work();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (job.entry != NO_ENTRY)
+            timeline[job.entry].worked = Now();
+        finished.push_back(std::move(job));
+    }
+}
+
+void AssetLoader::PendingTexture::AddRegion(int level, int layer, int regionWidth, int regionHeight, GLenum format,
+    const unsigned char* texels, size_t bytes, bool compressed) {
+    UploadRegion region;
+    region.compressed = compressed;
+    region.level = level;
+    region.layer = layer;
+    region.width = regionWidth;
+    region.height = regionHeight;
+    region.format = format;
+    region.texels = texels;
+    region.size = bytes;
+    region.offset = size;
+    regions.push_back(region);
+    size += bytes;
+}
+
+void AssetLoader::PendingTexture::AddMipChain(int layer, int chainWidth, int chainHeight, int channels, const unsigned char* chain) {
+    std::vector<MipLevel> mips = GetMipLayout(chainWidth, chainHeight, channels);
+    for (size_t level = 0; level < mips.size(); level++) {
+        AddRegion(static_cast<int>(level), layer, mips[level].width, mips[level].height, channels == 3 ? GL_RGB : GL_RGBA,
+            chain + mips[level].offset, mips[level].size);
+    }
+    levels = static_cast<int>(mips.size());
+    generateMips = false;
+}
+
+void AssetLoader::QueueUpload(const std::shared_ptr<PendingTexture>& texture, const std::string& name) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        texture->entry = AddEntry(name);
+        timeline[texture->entry].started = timeline[texture->entry].queued;
+        timeline[texture->entry].worked = timeline[texture->entry].queued;
+        outstanding++;
+    }
+    uploads.push_back(texture);
+}
+
+GLuint AssetLoader::LoadTexture(const std::string& path, const glm::vec4& placeholder) {
+    if (GLuint cached = textures.Find(path))
+        return cached;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    textures.Insert(path, textureID);
+    BindTextureToEdit(GL_TEXTURE_2D, textureID);
+    SetSamplerState(GL_TEXTURE_2D);
+
+    unsigned char texel[4];
+    PlaceholderTexels(placeholder, texel);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+
+    auto pending = std::make_shared<PendingTexture>();
+    pending->texture = textureID;
+    pending->target = GL_TEXTURE_2D;
+
+    // packed textures are decoded with their mips already, so without block compression
+    // there is no worker step
+    const AssetPack& pack = GetAssetPack();
+    const PackEntry* packed = pack.FindEntry(path, PackEntryType::Texture);
+    bool canBC1 = blockCompression && IsBlockFormatSupported(BlockFormat::BC1);
+    bool canBC7 = blockCompression && IsBlockFormatSupported(BlockFormat::BC7);
+    if (packed && !canBC1) {
+        pending->width = static_cast<int>(packed->width);
+        pending->height = static_cast<int>(packed->height);
+        pending->AddMipChain(0, pending->width, pending->height, static_cast<int>(packed->channels), pack.GetEntryData(*packed));
+        pending->format = packed->channels == 3 ? "RGB8 pack streamed" : "RGBA8 pack streamed";
+        BeginStreaming(*pending, path);
+        QueueUpload(pending, path + " (packed)");
+        return textureID;
+    }
+
+    pending->entry = Enqueue(textureQueue, path,
+        [this, pending, path, packed, canBC1, canBC7] {
+            // a current .bctex is the smallest upload and needs neither decoding nor mips; it
+            // stays mapped, so its finer levels can be streamed in (and out) later
+            auto cooked = std::make_shared<CookedTexture>();
+            auto useCooked = [&](const std::string& format) {
+                GLenum internalFormat = GetBlockInternalFormat(cooked->GetFormat());
+                const auto& levels = cooked->GetLevels();
+                for (size_t level = 0; level < levels.size(); level++) {
+                    pending->AddRegion(static_cast<int>(level), 0, levels[level].width, levels[level].height, internalFormat,
+                        levels[level].data, levels[level].size, true);
+                }
+                pending->width = cooked->GetWidth();
+                pending->height = cooked->GetHeight();
+                pending->levels = static_cast<int>(levels.size());
+                pending->generateMips = false;
+                pending->streamable = true;
+                pending->format = std::string(GetBlockFormatName(cooked->GetFormat())) + format;
+                pending->cooked = std::move(cooked);
+            };
+            if ((canBC1 || canBC7) && cooked->Open(path) && (cooked->GetFormat() == BlockFormat::BC7 ? canBC7 : canBC1)) {
+                useCooked(" .bctex streamed");
+                return;
+            }
+
+            const unsigned char* texels = nullptr;
+            int width = 0, height = 0, channels = 0;
+            if (packed) {
+                texels = GetAssetPack().GetEntryData(*packed);
+                width = static_cast<int>(packed->width);
+                height = static_cast<int>(packed->height);
+                channels = static_cast<int>(packed->channels);
+            }
+            else {
+                bool reused;
+                auto image = textures.Decode(path, &reused);
+                if (!image)
+                    return;
+                texels = image->texels.get();
+                width = image->width;
+                height = image->height;
+                channels = image->channels;
+                pending->decodeMs = reused ? 0.0 : image->decodeMs;
+                pending->sources.push_back(std::move(image));
+            }
+            pending->width = width;
+            pending->height = height;
+
+            // opaque images are cooked to BC1 now and uploaded compressed; the .bctex saves
+            // the decode, mip build and encode on the next start
+            if (canBC1 && channels == 3) {
+                std::vector<unsigned char> chain;
+                if (!packed)
+                    chain = BuildMipChain(texels, width, height, channels);
+                auto levels = CompressMipChainBC1(packed ? texels : chain.data(), width, height, channels);
+                if (!WriteCookedTexture(path, BlockFormat::BC1, width, height, levels))
+                    std::cerr << "Could not write the cooked texture for " << path << "\n";
+                else if (cooked->Open(path)) {
+                    // stream from the file just written, the encoded levels need not stay in memory
+                    pending->sources.clear();
+                    useCooked(packed ? " cooked from pack, streamed" : " cooked, streamed");
+                    return;
+                }
+                for (size_t level = 0; level < levels.size(); level++) {
+                    pending->images.push_back(std::move(levels[level]));
+                    pending->AddRegion(static_cast<int>(level), 0, std::max(1, width >> level), std::max(1, height >> level),
+                        GetBlockInternalFormat(BlockFormat::BC1), pending->images.back().data(), pending->images.back().size(), true);
+                }
+                pending->levels = static_cast<int>(levels.size());
+                pending->generateMips = false;
+                pending->format = packed ? "BC1 cooked from pack" : "BC1 cooked";
+                pending->sources.clear();
+                return;
+            }
+
+            if (packed) {
+                pending->AddMipChain(0, width, height, channels, texels);
+                pending->streamable = true;
+                pending->format = channels == 3 ? "RGB8 pack streamed" : "RGBA8 pack streamed";
+            }
+            else {
+                pending->AddRegion(0, 0, width, height, channels == 3 ? GL_RGB : GL_RGBA, texels, size_t(width) * height * channels);
+                pending->format = channels == 3 ? "RGB8" : "RGBA8";
+            }
+        },
+        [this, pending, path] {
+            if (pending->regions.empty()) {
+                MarkReady(pending->entry);
+                return;
+            }
+            if (pending->streamable)
+                BeginStreaming(*pending, path);
+            uploads.push_back(pending);
+        });
+    return textureID;
+}
+
+GLuint AssetLoader::LoadTextureArray(const std::vector<std::string>& paths, const std::vector<glm::vec4>& placeholders) {
+    std::string key;
+    for (const auto& path : paths)
+        key += path + "|";
+    if (GLuint cached = textures.Find(key))
+        return cached;
+
+    GLsizei layers = static_cast<GLsizei>(paths.size());
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    textures.Insert(key, textureID);
+    BindTextureToEdit(GL_TEXTURE_2D_ARRAY, textureID);
+    SetSamplerState(GL_TEXTURE_2D_ARRAY);
+
+    std::vector<unsigned char> texels(layers * 4);
+    for (GLsizei layer = 0; layer < layers; layer++)
+        PlaceholderTexels(layer < static_cast<GLsizei>(placeholders.size()) ? placeholders[layer] : glm::vec4(0.5f), &texels[layer * 4]);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+
+    auto pending = std::make_shared<PendingTexture>();
+    pending->texture = textureID;
+    pending->target = GL_TEXTURE_2D_ARRAY;
+    pending->layers = layers;
+
+    std::string name = paths.empty() ? "texture array" : paths[0] + " (+" + std::to_string(paths.size() - 1) + " layers)";
+    pending->entry = Enqueue(textureQueue, name,
+        [this, pending, paths] {
+            struct Layer {
+                const PackEntry* packed = nullptr;
+                const unsigned char* texels = nullptr;
+                int width = 0, height = 0, channels = 4;
+            };
+            const AssetPack& pack = GetAssetPack();
+            std::vector<Layer> images(paths.size());
+            int width = 1, height = 1;
+            bool allPacked = true;
+            for (size_t i = 0; i < paths.size(); i++) {
+                Layer& image = images[i];
+                image.packed = pack.FindEntry(paths[i], PackEntryType::Texture);
+                if (image.packed) {
+                    image.texels = pack.GetEntryData(*image.packed);
+                    image.width = static_cast<int>(image.packed->width);
+                    image.height = static_cast<int>(image.packed->height);
+                    image.channels = static_cast<int>(image.packed->channels);
+                }
+                else {
+                    allPacked = false;
+                    bool reused;
+                    auto decoded = textures.Decode(paths[i], &reused);
+                    if (!decoded)
+                        continue;
+                    image.texels = decoded->texels.get();
+                    image.width = decoded->width;
+                    image.height = decoded->height;
+                    image.channels = decoded->channels;
+                    if (!reused)
+                        pending->decodeMs += decoded->decodeMs;
+                    pending->sources.push_back(std::move(decoded));
+                }
+                width = glm::max(width, image.width);
+                height = glm::max(height, image.height);
+            }
+            pending->width = width;
+            pending->height = height;
+
+            // packed layers of the full size stream their mip chains untouched; the rest are
+            // resized (and, when every layer has packed mips, given a CPU-built chain to match)
+            for (size_t i = 0; i < images.size(); i++) {
+                Layer& image = images[i];
+                bool resized = false;
+                if (!image.texels) {
+                    // missing images stay transparent black
+                    pending->images.emplace_back(size_t(width) * height * 4, 0);
+                    image.texels = pending->images.back().data();
+                    image.width = width;
+                    image.height = height;
+                    image.channels = 4;
+                    resized = true;
+                }
+                else if (image.width != width || image.height != height) {
+                    std::vector<unsigned char> rgba;
+                    const unsigned char* source = image.texels;
+                    if (image.channels == 3) {
+                        rgba.resize(size_t(image.width) * image.height * 4);
+                        for (size_t t = 0; t < rgba.size() / 4; t++) {
+                            std::memcpy(&rgba[t * 4], image.texels + t * 3, 3);
+                            rgba[t * 4 + 3] = 255;
+                        }
+                        source = rgba.data();
+                    }
+                    pending->images.push_back(ResizeRGBA(source, image.width, image.height, width, height));
+                    image.texels = pending->images.back().data();
+                    image.width = width;
+                    image.height = height;
+                    image.channels = 4;
+                    resized = true;
+                }
+
+                int layer = static_cast<int>(i);
+                if (!allPacked) {
+                    pending->AddRegion(0, layer, width, height, image.channels == 3 ? GL_RGB : GL_RGBA, image.texels,
+                        size_t(width) * height * image.channels);
+                }
+                else if (image.packed && !resized) {
+                    pending->AddMipChain(layer, width, height, image.channels, image.texels);
+                }
+                else {
+                    pending->images.push_back(BuildMipChain(image.texels, width, height, image.channels));
+                    pending->AddMipChain(layer, width, height, image.channels, pending->images.back().data());
+                }
+            }
+            pending->format = allPacked ? "RGBA8 pack" : "RGBA8";
+        },
+        [this, pending] {
+            if (!pending->regions.empty())
+                uploads.push_back(pending);
+            else
+                MarkReady(pending->entry);
+        });
+    return textureID;
+}
+
+bool AssetLoader::StreamTexture(PendingTexture& texture, size_t& budget) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture.pbo);
+
+    // fill the unpack buffer a slice at a time; the texture keeps its placeholder until the last one
+    size_t count = std::min(budget, texture.size - texture.uploaded);
+    if (count > 0) {
+        unsigned char* dst = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, texture.uploaded, count,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+        size_t sliceStart = texture.uploaded;
+        size_t end = texture.uploaded + count;
+        while (texture.uploaded < end) {
+            const UploadRegion& region = texture.regions[texture.nextRegion];
+            size_t from = texture.uploaded - region.offset;
+            size_t bytes = std::min(region.size - from, end - texture.uploaded);
+            if (dst)
+                std::memcpy(dst + (texture.uploaded - sliceStart), region.texels + from, bytes);
+            else
+                glBufferSubData(GL_PIXEL_UNPACK_BUFFER, texture.uploaded, bytes, region.texels + from);
+            texture.uploaded += bytes;
+            if (from + bytes == region.size)
+                texture.nextRegion++;
+        }
+        if (dst)
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        budget -= count;
+    }
+
+    if (texture.uploaded < texture.size)
+        return false;
+
+    // everything is staged: swap the placeholder for the real image straight from the buffer
+    BindTextureToEdit(texture.target, texture.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (texture.target == GL_TEXTURE_2D_ARRAY) {
+        // storage first, with no buffer bound so a null pointer means no data
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        for (int level = 0; level < texture.levels; level++) {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, glm::max(1, texture.width >> level), glm::max(1, texture.height >> level),
+                texture.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture.pbo);
+        for (const auto& region : texture.regions) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, region.level, 0, 0, region.layer, region.width, region.height, 1,
+                region.format, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(region.offset));
+        }
+    }
+    else {
+        for (const auto& region : texture.regions) {
+            if (region.compressed) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, region.level, region.format, region.width, region.height, 0,
+                    static_cast<GLsizei>(region.size), reinterpret_cast<const void*>(region.offset));
+                continue;
+            }
+            GLint internalFormat = region.format == GL_RGB ? GL_RGB8 : GL_RGBA8;
+            glTexImage2D(GL_TEXTURE_2D, region.level, internalFormat, region.width, region.height, 0,
+                region.format, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(region.offset));
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (texture.generateMips)
+        glGenerateMipmap(texture.target);
+    return true;
+}
+
+void AssetLoader::Update(size_t uploadBudgetBytes) {
+    frame++;
+    std::vector<Job> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(finished);
+    }
+
+    for (auto& job : done) {
+        if (job.finish)
+            job.finish();
+        if (!job.readyOnUpload)
+            MarkReady(job.entry);
+    }
+
+    size_t budget = uploadBudgetBytes;
+    while (!uploads.empty() && budget > 0) {
+        PendingTexture& texture = *uploads.front();
+        if (texture.pbo == 0) {
+            glGenBuffers(1, &texture.pbo);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture.pbo);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, texture.size, nullptr, GL_STREAM_DRAW);
+        }
+
+        auto uploadStart = std::chrono::steady_clock::now();
+        bool complete = StreamTexture(texture, budget);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        texture.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+        texture.uploadFrames++;
+        if (!complete)
+            break;
+
+        if (texture.baseLevel >= 0) {
+            // a partial chain: sample from its finest level only
+            BindTextureToEdit(GL_TEXTURE_2D, texture.texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.baseLevel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+
+            StreamedTexture& record = streamed[streamedIndex[texture.texture]];
+            record.resident = record.streaming;
+            record.streaming = -1;
+            peakResident = std::max(peakResident, GetResidentBytes());
+            if (texture.streamed) {
+                double latency = Now() - record.requested;
+                int frames = frame - record.requestedFrame;
+                streamCount++;
+                streamLatencyTotal += latency;
+                streamLatencyMax = std::max(streamLatencyMax, latency);
+                streamFramesTotal += frames;
+                streamFramesMax = std::max(streamFramesMax, frames);
+                std::cout << "Streamed " << record.name << " mips " << texture.baseLevel << "-" << texture.regions.back().level
+                    << " in " << std::fixed << std::setprecision(1) << latency << " ms (" << frames << " frames), textures resident "
+                    << ToMB(GetResidentBytes())
+                    << " MB" << std::defaultfloat << std::setprecision(6) << "\n";
+            }
+        }
+
+        if (!texture.streamed) {
+            TextureCache::TextureStats stats;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.name = timeline[texture.entry].name;
+            }
+            stats.width = texture.width;
+            stats.height = texture.height;
+            stats.layers = texture.layers;
+            stats.format = texture.format;
+            stats.bytes = texture.size;
+            // what the texture occupies as uploaded, mips the driver generates included; arrays are
+            // always stored as RGBA8 with a full chain
+            stats.vramBytes = texture.generateMips ? texture.size * 4 / 3 : texture.size;
+            if (texture.target == GL_TEXTURE_2D_ARRAY)
+                stats.vramBytes = size_t(texture.width) * texture.height * 4 * texture.layers * 4 / 3;
+            stats.decodeMs = texture.decodeMs;
+            stats.uploadMs = texture.uploadMs;
+            stats.uploadFrames = texture.uploadFrames;
+            textures.Record(stats);
+        }
+
+        glDeleteBuffers(1, &texture.pbo);
+        texture.regions.clear();
+        std::vector<std::vector<unsigned char>>().swap(texture.images);
+        texture.sources.clear();
+        texture.cooked.reset();
+
+        if (!texture.streamed)
+            MarkReady(texture.entry);
+        uploads.pop_front();
+    }
+
+    if (!streamed.empty())
+        UpdateStreaming();
+
+    if (!timelinePrinted && IsIdle()) {
+        PrintTimeline();
+        textures.PrintStats();
+        timelinePrinted = true;
+    }
+}
+
+bool AssetLoader::IsIdle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return outstanding == 0;
+}
+
+void AssetLoader::PrintTimeline() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << "Asset timeline (ms since loader start: queued, worker start-end, ready on GPU):\n";
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& entry : timeline) {
+        std::cout << "  " << std::setw(8) << entry.queued << "  " << std::setw(8) << entry.started << " - "
+            << std::setw(8) << entry.worked << "  " << std::setw(8) << entry.ready << "  " << entry.name << "\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+size_t AssetLoader::StreamedTexture::GetBytes(int finest) const {
+    size_t bytes = 0;
+    for (size_t level = std::max(finest, 0); level < levels.size(); level++)
+        bytes += levels[level].size;
+    return bytes;
+}
+
+void AssetLoader::BeginStreaming(PendingTexture& texture, const std::string& name) {
+    StreamedTexture record;
+    record.texture = texture.texture;
+    record.name = name;
+    record.cooked = texture.cooked;
+    record.levels = texture.regions;
+    record.resident = static_cast<int>(record.levels.size());
+    record.tail = record.resident - 1;
+    while (record.tail > 0 && std::max(record.levels[record.tail - 1].width, record.levels[record.tail - 1].height) <= STREAM_TAIL_SIZE)
+        record.tail--;
+    record.streaming = record.tail;
+    record.requested = Now();
+    record.lastWanted = record.requested;
+    record.wanted = static_cast<float>(record.tail);
+
+    // only the tail goes up with the load, so the texture shows within a frame or two
+    texture.regions.clear();
+    texture.size = 0;
+    for (size_t level = record.tail; level < record.levels.size(); level++) {
+        const UploadRegion& region = record.levels[level];
+        texture.AddRegion(region.level, 0, region.width, region.height, region.format, region.texels, region.size, region.compressed);
+    }
+    texture.baseLevel = record.tail;
+
+    streamedIndex[record.texture] = streamed.size();
+    streamed.push_back(std::move(record));
+}
+
+void AssetLoader::RequestTextureDetail(GLuint texture, float uvPerPixel) {
+    auto found = streamedIndex.find(texture);
+    if (found == streamedIndex.end())
+        return;
+    // one texel per pixel at level 0 means uvPerPixel * size == 1
+    StreamedTexture& record = streamed[found->second];
+    float size = static_cast<float>(std::max(record.levels[0].width, record.levels[0].height));
+    float level = std::log2(std::max(uvPerPixel * size, 1e-6f));
+    record.wanted = std::min(record.wanted, level);
+    record.requestedDetail = true;
+}
+
+void AssetLoader::UpdateStreaming() {
+    double now = Now();
+
+    // each texture's target: the finest level asked for, with levels kept a while after they
+    // stop being needed so a camera hovering at a boundary does not reload them every frame
+    std::vector<int> targets(streamed.size());
+    for (size_t i = 0; i < streamed.size(); i++) {
+        StreamedTexture& record = streamed[i];
+        int wanted = !record.requestedDetail ? 0
+            : record.wanted < record.tail ? std::max(0, static_cast<int>(std::floor(record.wanted))) : record.tail;
+        int current = record.streaming >= 0 ? record.streaming : record.resident;
+        if (wanted <= current)
+            record.lastWanted = now;
+        targets[i] = wanted > current && now - record.lastWanted < STREAM_DROP_DELAY_MS ? current : wanted;
+        record.wanted = static_cast<float>(record.tail);
+    }
+
+    // over budget: coarsen whichever texture holds the largest level until everything fits
+    if (memoryBudget > 0) {
+        size_t total = 0;
+        for (size_t i = 0; i < streamed.size(); i++)
+            total += streamed[i].GetBytes(targets[i]);
+        while (total > memoryBudget) {
+            size_t largest = streamed.size();
+            for (size_t i = 0; i < streamed.size(); i++) {
+                if (targets[i] < streamed[i].tail &&
+                    (largest == streamed.size() || streamed[i].levels[targets[i]].size > streamed[largest].levels[targets[largest]].size))
+                    largest = i;
+            }
+            if (largest == streamed.size())
+                break;
+            total -= streamed[largest].levels[targets[largest]].size;
+            targets[largest]++;
+        }
+    }
+
+    // one change per texture at a time; a texture with an upload in flight waits for it
+    for (size_t i = 0; i < streamed.size(); i++) {
+        StreamedTexture& record = streamed[i];
+        if (record.streaming >= 0)
+            continue;
+        if (targets[i] < record.resident)
+            StreamLevels(record, targets[i]);
+        else if (targets[i] > record.resident)
+            DropLevels(record, targets[i]);
+    }
+}
+
+void AssetLoader::StreamLevels(StreamedTexture& texture, int finest) {
+    auto pending = std::make_shared<PendingTexture>();
+    pending->texture = texture.texture;
+    pending->target = GL_TEXTURE_2D;
+    pending->width = texture.levels[0].width;
+    pending->height = texture.levels[0].height;
+    pending->levels = static_cast<int>(texture.levels.size());
+    pending->generateMips = false;
+    pending->streamed = true;
+    pending->baseLevel = finest;
+    pending->cooked = texture.cooked;
+    for (int level = finest; level < texture.resident; level++) {
+        const UploadRegion& region = texture.levels[level];
+        pending->AddRegion(region.level, 0, region.width, region.height, region.format, region.texels, region.size, region.compressed);
+    }
+    texture.streaming = finest;
+    texture.requested = Now();
+    texture.requestedFrame = frame;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        streamQueue.push_back({ NO_ENTRY, true,
+            [pending] {
+                for (const auto& region : pending->regions)
+                    Prefetch(region.texels, region.size);
+            },
+            [this, pending] { uploads.push_back(pending); } });
+    }
+    wake.notify_one();
+}
+
+void AssetLoader::DropLevels(StreamedTexture& texture, int finest) {
+    // stop sampling the levels first, then respecify them empty so the driver frees them
+    BindTextureToEdit(GL_TEXTURE_2D, texture.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, finest);
+    for (int level = texture.resident; level < finest; level++) {
+        const UploadRegion& region = texture.levels[level];
+        if (region.compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, region.format, 0, 0, 0, 0, nullptr);
+        else
+            glTexImage2D(GL_TEXTURE_2D, level, region.format == GL_RGB ? GL_RGB8 : GL_RGBA8, 0, 0, 0, region.format, GL_UNSIGNED_BYTE, nullptr);
+    }
+    std::cout << "Dropped " << texture.name << " mips " << texture.resident << "-" << finest - 1;
+    texture.resident = finest;
+    dropCount++;
+    std::cout << ", textures resident " << std::fixed << std::setprecision(1) << ToMB(GetResidentBytes()) << " MB"
+        << std::defaultfloat << std::setprecision(6) << "\n";
+}
+
+size_t AssetLoader::GetResidentBytes() const {
+    size_t bytes = 0;
+    for (const auto& texture : streamed)
+        bytes += texture.GetBytes(texture.resident);
+    return bytes;
+}
+
+void AssetLoader::PrintStreamingStats() const {
+    if (streamed.empty())
+        return;
+    size_t full = 0;
+    for (const auto& texture : streamed)
+        full += texture.GetBytes(0);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Texture streaming: " << streamed.size() << " textures, " << ToMB(GetResidentBytes()) << " MB resident (peak "
+        << ToMB(peakResident) << ", budget ";
+    if (memoryBudget > 0)
+        std::cout << ToMB(memoryBudget) << " MB";
+    else
+        std::cout << "none";
+    std::cout << ", full chains " << ToMB(full) << " MB)\n";
+    std::cout << "  " << streamCount << " streams, latency avg " << (streamCount > 0 ? streamLatencyTotal / streamCount : 0.0)
+        << " ms max " << streamLatencyMax << " ms (frames avg " << (streamCount > 0 ? double(streamFramesTotal) / streamCount : 0.0)
+        << " max " << streamFramesMax << "), " << dropCount << " drops\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+void AssetLoader::Cleanup() {
+    PrintStreamingStats();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+        textureQueue.clear();
+        streamQueue.clear();
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+
+    for (auto& texture : uploads)
+        glDeleteBuffers(1, &texture->pbo);
+    uploads.clear();
+    finished.clear();
+    streamed.clear();
+    streamedIndex.clear();
+    textures.Cleanup();
+}
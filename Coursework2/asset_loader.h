@@ -0,0 +1,171 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/gl3w.h>
+#include "texture_cache.h"
+#include "texture_cook.h"
+
+// Startup asset loading off the GL thread. Workers do file I/O and decoding; the GL
+// thread only runs each job's finish step and streams decoded texels through a pixel
+// unpack buffer, a budgeted number of bytes per frame. Textures are created right away
+// with a 1x1 placeholder color so they can be bound before the real image arrives.
+// Textures in the asset pack skip decoding: their mip chains stream from the mapping.
+// Opaque textures are cooked to BC1 on first load and come from their .bctex after that.
+// Every texture goes through a TextureCache, so a path is decoded and uploaded once.
+// 2D textures whose mip chain stays mapped (.bctex or pack) are streamed: the small tail
+// levels go up first, finer levels follow on demand within a memory budget.
+class AssetLoader {
+public:
+    void Init(int threadCount = 0);
+    // off: no .bctex lookups or cooking, textures upload uncompressed; for rasterizers that
+    // decode blocks in software, where BC formats cost more per sample than they save
+    void SetBlockCompression(bool enabled) { blockCompression = enabled; }
+
+    // work runs on a worker, finish (if any) on the GL thread during a later Update
+    void Submit(const std::string& name, std::function<void()> work, std::function<void()> finish = nullptr);
+
+    // both return the cached texture for a path (or list of paths) requested before; the
+    // cache owns the texture, Cleanup deletes it
+    GLuint LoadTexture(const std::string& path, const glm::vec4& placeholder);
+    // one RGBA layer per path, resized to the largest image, with a placeholder color per layer
+    GLuint LoadTextureArray(const std::vector<std::string>& paths, const std::vector<glm::vec4>& placeholders);
+
+    // streamed textures: callers report every frame how many texture coordinate units one
+    // screen pixel covers where the texture is drawn closest; the loader turns that into the
+    // finest mip worth keeping and spends the budget (0 = unlimited) on the most wanted levels;
+    // textures nobody reports on are given their whole chain
+    void RequestTextureDetail(GLuint texture, float uvPerPixel);
+    void SetTextureMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+
+    // GL thread, once per frame
+    void Update(size_t uploadBudgetBytes);
+    bool IsIdle() const;
+    void PrintTimeline() const;
+    void Cleanup();
+
+private:
+    // one row of the startup timeline, times in ms since Init
+    struct TimelineEntry {
+        std::string name;
+        double queued = 0.0;
+        double started = -1.0;
+        double worked = -1.0;
+        double ready = -1.0;
+    };
+
+    static const size_t NO_ENTRY = ~size_t(0);    // stream jobs stay off the timeline
+
+    struct Job {
+        size_t entry;
+        bool readyOnUpload;
+        std::function<void()> work;
+        std::function<void()> finish;
+    };
+
+    // one mip level of one layer, staged at offset in the unpack buffer
+    struct UploadRegion {
+        int level = 0, layer = 0;
+        int width = 0, height = 0;
+        GLenum format = GL_RGBA;   // internal format when compressed
+        bool compressed = false;
+        const unsigned char* texels = nullptr;
+        size_t size = 0;
+        size_t offset = 0;
+    };
+
+    // texels waiting for, or in the middle of, their upload; regions point into the
+    // pack mapping or into images this texture owns
+    struct PendingTexture {
+        size_t entry = 0;
+        GLuint texture = 0;
+        GLenum target = GL_TEXTURE_2D;
+        int width = 0, height = 0, layers = 1, levels = 1;
+        bool generateMips = true;
+        bool streamable = false;    // regions are the whole mip chain and stay readable
+        bool streamed = false;      // finer levels of a streamed texture, not a load
+        int baseLevel = -1;         // finest level once uploaded, for partial chains
+        std::vector<std::vector<unsigned char>> images;
+        std::vector<std::shared_ptr<const DecodedImage>> sources;
+        std::shared_ptr<CookedTexture> cooked;
+        std::string format;
+        double decodeMs = 0.0;
+        double uploadMs = 0.0;
+        int uploadFrames = 0;
+        std::vector<UploadRegion> regions;
+        size_t size = 0;
+        size_t uploaded = 0;
+        size_t nextRegion = 0;
+        GLuint pbo = 0;
+
+        void AddRegion(int level, int layer, int regionWidth, int regionHeight, GLenum format, const unsigned char* texels, size_t bytes,
+            bool compressed = false);
+        // every level of a chain laid out by GetMipLayout
+        void AddMipChain(int layer, int chainWidth, int chainHeight, int channels, const unsigned char* chain);
+    };
+
+    size_t Enqueue(std::deque<Job>& target, const std::string& name, std::function<void()> work, std::function<void()> finish);
+    size_t AddEntry(const std::string& name);
+    void MarkReady(size_t entry);
+    double Now() const;
+    void WorkerLoop();
+    void QueueUpload(const std::shared_ptr<PendingTexture>& texture, const std::string& name);
+    bool StreamTexture(PendingTexture& texture, size_t& budget);
+
+    // a texture whose levels can be dropped and uploaded again from their mapping
+    struct StreamedTexture {
+        GLuint texture = 0;
+        std::string name;
+        std::shared_ptr<CookedTexture> cooked;      // keeps a .bctex mapped; pack data lives as long as the pack
+        std::vector<UploadRegion> levels;
+        int tail = 0;               // levels from here down are never dropped
+        int resident = 0;           // finest level on the GPU, levels.size() before the first upload
+        int streaming = -1;         // finest level of the upload in flight
+        bool requestedDetail = false;   // until a caller asks, the whole chain is wanted
+        float wanted = 0.0f;        // finest level asked for since the last update
+        double lastWanted = 0.0;    // when the resident level was last still needed
+        double requested = 0.0;     // when the upload in flight was started
+        int requestedFrame = 0;
+
+        size_t GetBytes(int finest) const;
+    };
+    void BeginStreaming(PendingTexture& texture, const std::string& name);
+    void UpdateStreaming();
+    void StreamLevels(StreamedTexture& texture, int finest);
+    void DropLevels(StreamedTexture& texture, int finest);
+    size_t GetResidentBytes() const;
+    void PrintStreamingStats() const;
+
+    TextureCache textures;
+    std::chrono::steady_clock::time_point start;
+    std::vector<std::thread> workers;
+    std::deque<Job> queue;
+    std::deque<Job> textureQueue;   // decoded after everything else, textures already have placeholders
+    std::deque<Job> streamQueue;    // finer levels for textures that are already showing
+    std::vector<Job> finished;
+    std::vector<TimelineEntry> timeline;
+    std::deque<std::shared_ptr<PendingTexture>> uploads;
+    size_t outstanding = 0;         // submitted jobs whose finish step has not run yet
+    bool stopping = false;
+    bool timelinePrinted = false;
+    bool blockCompression = true;
+
+    std::vector<StreamedTexture> streamed;
+    std::unordered_map<GLuint, size_t> streamedIndex;
+    size_t memoryBudget = 0;
+    size_t peakResident = 0;
+    int frame = 0;
+    int streamCount = 0, dropCount = 0;
+    int streamFramesTotal = 0, streamFramesMax = 0;
+    double streamLatencyTotal = 0.0, streamLatencyMax = 0.0;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+};
@@ -0,0 +1,392 @@
+#include "asset_pack.h"
+#include "mesh_cache.h"
+#include "obj_loader.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char PACK_MAGIC[4] = { 'A', 'P', 'A', 'K' };
+const uint32_t PACK_VERSION = 2;
+const size_t PAGE_SIZE = 4096;
+const size_t MIP_ALIGNMENT = 64;
+const size_t SHADER_ALIGNMENT = 64;
+
+// layout: header, section table, then one page-aligned section per entry type,
+// with the table of contents and its string table at the end
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t sectionCount;
+    uint64_t tocOffset;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+};
+
+struct PackSection {
+    uint32_t type;
+    uint32_t entryCount;
+    uint64_t offset;
+    uint64_t size;
+};
+
+const PackEntryType SECTION_ORDER[] = { PackEntryType::Texture, PackEntryType::Mesh, PackEntryType::Shader };
+const uint32_t SECTION_COUNT = 3;
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool GetSourceStamp(const std::string& path, int64_t& time, uint64_t& size) {
+    std::error_code ec;
+    size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    if (ec)
+        return false;
+    time = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    return !ec;
+}
+
+// a loose file that is absent is fine (pack-only install), one that is present has to match
+bool SourceUnchanged(const std::string& name, const PackEntry& entry) {
+    int64_t time;
+    uint64_t size;
+    if (!GetSourceStamp(name, time, size))
+        return true;
+    if (size != entry.sourceSize)
+        return false;
+    if (time == entry.sourceTime)
+        return true;
+    uint64_t hash = 0;
+    return HashFile(name, hash) && hash == entry.sourceHash;
+}
+
+bool ClassifySource(const std::filesystem::path& path, PackEntryType& type) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".tga" || ext == ".bmp")
+        type = PackEntryType::Texture;
+    else if (ext == ".obj")
+        type = PackEntryType::Mesh;
+    else if (ext == ".vert" || ext == ".frag" || ext == ".geom" || ext == ".comp" || ext == ".glsl")
+        type = PackEntryType::Shader;
+    else
+        return false;
+    return true;
+}
+
+const char* TypeName(PackEntryType type) {
+    switch (type) {
+    case PackEntryType::Texture: return "texture";
+    case PackEntryType::Mesh: return "mesh";
+    default: return "shader";
+    }
+}
+
+bool CookTexture(const std::string& name, std::ostream& out, PackEntry& entry) {
+    // same channel rule as the runtime loader and the cooker
+    int width, height, channels;
+    if (!stbi_info(name.c_str(), &width, &height, &channels)) {
+        std::cerr << "Pack: could not read image " << name << "\n";
+        return false;
+    }
+    int wanted = GetDecodeChannels(channels);
+    unsigned char* data = stbi_load(name.c_str(), &width, &height, &channels, wanted);
+    if (!data) {
+        std::cerr << "Pack: could not decode " << name << "\n";
+        return false;
+    }
+    std::vector<unsigned char> chain = BuildMipChain(data, width, height, wanted);
+    stbi_image_free(data);
+
+    out.write(reinterpret_cast<const char*>(chain.data()), chain.size());
+    entry.width = static_cast<uint32_t>(width);
+    entry.height = static_cast<uint32_t>(height);
+    entry.channels = static_cast<uint32_t>(wanted);
+    entry.mipCount = static_cast<uint32_t>(GetMipLayout(width, height, wanted).size());
+    return true;
+}
+
+bool CookShader(const std::string& name, std::ostream& out) {
+    MappedFile source;
+    if (source.Open(name))
+        out.write(reinterpret_cast<const char*>(source.GetData()), source.GetSize());
+    out.put('\0');
+    return true;
+}
+
+}
+
+int GetDecodeChannels(int sourceChannels) {
+    return sourceChannels == 2 || sourceChannels == 4 ? 4 : 3;
+}
+
+std::vector<MipLevel> GetMipLayout(int width, int height, int channels) {
+    std::vector<MipLevel> levels;
+    size_t offset = 0;
+    for (;;) {
+        MipLevel level;
+        level.offset = offset;
+        level.size = size_t(width) * height * channels;
+        level.width = width;
+        level.height = height;
+        levels.push_back(level);
+        if (width == 1 && height == 1)
+            break;
+        offset = AlignUp(offset + level.size, MIP_ALIGNMENT);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return levels;
+}
+
+std::vector<unsigned char> BuildMipChain(const unsigned char* texels, int width, int height, int channels) {
+    std::vector<MipLevel> levels = GetMipLayout(width, height, channels);
+    std::vector<unsigned char> chain(levels.back().offset + levels.back().size);
+    std::memcpy(chain.data(), texels, levels[0].size);
+
+    // 2x2 box filter, clamped at the edge of odd-sized levels like glGenerateMipmap
+    for (size_t l = 1; l < levels.size(); l++) {
+        const MipLevel& src = levels[l - 1];
+        const MipLevel& dst = levels[l];
+        const unsigned char* in = chain.data() + src.offset;
+        unsigned char* outTexels = chain.data() + dst.offset;
+        for (int y = 0; y < dst.height; y++) {
+            int y0 = std::min(y * 2, src.height - 1);
+            int y1 = std::min(y * 2 + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++) {
+                int x0 = std::min(x * 2, src.width - 1);
+                int x1 = std::min(x * 2 + 1, src.width - 1);
+                for (int c = 0; c < channels; c++) {
+                    unsigned int sum = in[(size_t(y0) * src.width + x0) * channels + c] + in[(size_t(y0) * src.width + x1) * channels + c]
+                        + in[(size_t(y1) * src.width + x0) * channels + c] + in[(size_t(y1) * src.width + x1) * channels + c];
+                    outTexels[(size_t(y) * dst.width + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+    return chain;
+}
+
+std::string NormalizeAssetName(const std::string& path) {
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+bool AssetPack::Open(const std::string& path) {
+    Close();
+    if (!file.Open(path))
+        return false;
+
+    const unsigned char* base = file.GetData();
+    size_t size = file.GetSize();
+    PackHeader header;
+    if (size < sizeof(header)) {
+        file.Close();
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, PACK_MAGIC, 4) != 0 || header.version != PACK_VERSION
+        || header.tocOffset + header.entryCount * sizeof(PackEntry) > size
+        || header.stringOffset + header.stringSize > size) {
+        std::cerr << "Asset pack: " << path << " is not a version " << PACK_VERSION << " archive, repack with --pack\n";
+        file.Close();
+        return false;
+    }
+
+    const PackEntry* toc = reinterpret_cast<const PackEntry*>(base + header.tocOffset);
+    const char* strings = reinterpret_cast<const char*>(base + header.stringOffset);
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const PackEntry& entry = toc[i];
+        if (entry.offset + entry.size > size || entry.nameOffset + uint64_t(entry.nameLength) > header.stringSize) {
+            std::cerr << "Asset pack: " << path << " has a damaged table of contents\n";
+            Close();
+            return false;
+        }
+        entries[std::string(strings + entry.nameOffset, entry.nameLength)] = &entry;
+    }
+    return true;
+}
+
+void AssetPack::Close() {
+    entries.clear();
+    file.Close();
+}
+
+const PackEntry* AssetPack::FindPacked(const std::string& name) const {
+    auto it = entries.find(name);
+    return it == entries.end() ? nullptr : it->second;
+}
+
+const PackEntry* AssetPack::FindEntry(const std::string& name, PackEntryType type) const {
+    if (entries.empty())
+        return nullptr;
+    std::string key = NormalizeAssetName(name);
+    const PackEntry* entry = FindPacked(key);
+    if (!entry || entry->type != static_cast<uint32_t>(type))
+        return nullptr;
+    if (!SourceUnchanged(key, *entry)) {
+        std::cerr << "Asset pack: " << key << " changed since packing, loading the loose file\n";
+        return nullptr;
+    }
+    return entry;
+}
+
+AssetPack& GetAssetPack() {
+    static AssetPack pack;
+    return pack;
+}
+
+bool BuildAssetPack(const std::string& packPath, const std::vector<std::string>& roots) {
+    auto start = std::chrono::steady_clock::now();
+
+    struct Source {
+        PackEntryType type;
+        std::string name;
+    };
+    std::vector<Source> sources;
+    for (const auto& root : roots) {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            PackEntryType type;
+            if (it->is_regular_file() && ClassifySource(it->path(), type))
+                sources.push_back({ type, NormalizeAssetName(it->path().string()) });
+        }
+    }
+    // grouped by section, sorted within it so repacks are deterministic
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) {
+        return a.type != b.type ? a.type < b.type : a.name < b.name;
+    });
+
+    // unchanged entries are copied from the previous archive instead of being cooked again
+    AssetPack previous;
+    previous.Open(packPath);
+
+    std::string tempPath = packPath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Pack: could not create " << tempPath << "\n";
+        return false;
+    }
+
+    const char padding[PAGE_SIZE] = {};
+    auto padTo = [&](size_t alignment) {
+        size_t pos = static_cast<size_t>(out.tellp());
+        size_t target = AlignUp(pos, alignment);
+        out.write(padding, static_cast<std::streamsize>(target - pos));
+        return target;
+    };
+
+    PackHeader header = {};
+    std::memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = PACK_VERSION;
+    header.sectionCount = SECTION_COUNT;
+    PackSection sections[SECTION_COUNT] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+
+    // every cooked image decodes the way the runtime loader expects
+    stbi_set_flip_vertically_on_load(true);
+
+    std::vector<PackEntry> toc;
+    std::string strings;
+    size_t cooked = 0, reused = 0;
+    size_t next = 0;
+    for (uint32_t s = 0; s < SECTION_COUNT; s++) {
+        PackSection& section = sections[s];
+        section.type = static_cast<uint32_t>(SECTION_ORDER[s]);
+        section.offset = padTo(PAGE_SIZE);
+
+        for (; next < sources.size() && sources[next].type == SECTION_ORDER[s]; next++) {
+            const Source& source = sources[next];
+            auto entryStart = std::chrono::steady_clock::now();
+
+            PackEntry entry = {};
+            entry.type = static_cast<uint32_t>(source.type);
+            if (!GetSourceStamp(source.name, entry.sourceTime, entry.sourceSize) || !HashFile(source.name, entry.sourceHash)) {
+                std::cerr << "Pack: could not read " << source.name << "\n";
+                continue;
+            }
+            entry.offset = padTo(source.type == PackEntryType::Shader ? SHADER_ALIGNMENT : PAGE_SIZE);
+
+            const PackEntry* old = previous.FindPacked(source.name);
+            bool reuse = old && old->type == entry.type && old->sourceSize == entry.sourceSize && old->sourceHash == entry.sourceHash;
+            bool ok = true;
+            if (reuse) {
+                out.write(reinterpret_cast<const char*>(previous.GetEntryData(*old)), static_cast<std::streamsize>(old->size));
+                entry.width = old->width;
+                entry.height = old->height;
+                entry.channels = old->channels;
+                entry.mipCount = old->mipCount;
+            }
+            else if (source.type == PackEntryType::Texture) {
+                ok = CookTexture(source.name, out, entry);
+            }
+            else if (source.type == PackEntryType::Mesh) {
+                std::vector<MeshSegment> segments = LoadMeshByMaterial(source.name);
+                ok = WriteMeshCacheImage(out, segments, entry.sourceTime, entry.sourceSize, entry.sourceHash);
+            }
+            else {
+                ok = CookShader(source.name, out);
+            }
+            if (!ok) {
+                out.seekp(static_cast<std::streamoff>(entry.offset));
+                continue;
+            }
+
+            entry.size = static_cast<uint64_t>(out.tellp()) - entry.offset;
+            entry.nameOffset = static_cast<uint32_t>(strings.size());
+            entry.nameLength = static_cast<uint32_t>(source.name.size());
+            strings += source.name;
+            toc.push_back(entry);
+            section.entryCount++;
+            (reuse ? reused : cooked)++;
+
+            std::cout << "  " << (reuse ? "reused " : "cooked ") << TypeName(source.type) << " " << source.name;
+            if (source.type == PackEntryType::Texture)
+                std::cout << " (" << entry.width << "x" << entry.height << "x" << entry.channels << ", " << entry.mipCount << " mips)";
+            std::cout << " " << entry.size / 1024.0 << " KB in " << MillisecondsSince(entryStart) << " ms\n";
+        }
+        section.size = static_cast<uint64_t>(out.tellp()) - section.offset;
+    }
+
+    header.entryCount = static_cast<uint32_t>(toc.size());
+    header.tocOffset = padTo(PAGE_SIZE);
+    out.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(PackEntry));
+    header.stringOffset = static_cast<uint64_t>(out.tellp());
+    header.stringSize = strings.size();
+    out.write(strings.data(), strings.size());
+    size_t total = static_cast<size_t>(out.tellp());
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+    out.close();
+    if (!out) {
+        std::cerr << "Pack: failed writing " << tempPath << "\n";
+        return false;
+    }
+
+    // the old archive has to be unmapped before it can be replaced
+    previous.Close();
+    std::error_code ec;
+    std::filesystem::rename(tempPath, packPath, ec);
+    if (ec) {
+        std::cerr << "Pack: could not replace " << packPath << ": " << ec.message() << "\n";
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+
+    std::cout << "Pack: " << packPath << " " << toc.size() << " entries (" << cooked << " cooked, " << reused << " reused), "
+        << total / (1024.0 * 1024.0) << " MB in " << MillisecondsSince(start) << " ms\n";
+    return true;
+}
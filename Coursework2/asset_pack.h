@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mapped_file.h"
+
+enum class PackEntryType : uint32_t {
+    Texture = 1,    // decoded texels, flipped for GL, full mip chain back to back
+    Mesh = 2,       // the .meshcache image of an OBJ
+    Shader = 3,     // GLSL source, NUL terminated
+};
+
+// table of contents record, stored as-is in the archive
+struct PackEntry {
+    uint32_t type;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t channels;      // textures: 3 or 4
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint32_t reserved;
+    uint64_t offset;        // from the start of the archive, page aligned for textures and meshes
+    uint64_t size;
+    int64_t sourceTime;
+    uint64_t sourceSize;
+    uint64_t sourceHash;    // content hash of the loose file, used for incremental repacking
+};
+
+// one level of a texture's mip chain, offset from the start of the chain
+struct MipLevel {
+    size_t offset;
+    size_t size;
+    int width;
+    int height;
+};
+
+// channels to decode an image with, given its own: 4 when it has alpha (grey+alpha or
+// RGBA), 3 otherwise, so greyscale expands to RGB and stays eligible for BC1
+int GetDecodeChannels(int sourceChannels);
+// tightly packed levels down to 1x1, each starting on a 64 byte boundary
+std::vector<MipLevel> GetMipLayout(int width, int height, int channels);
+// box-filtered mip chain in GetMipLayout order, level 0 copied from texels
+std::vector<unsigned char> BuildMipChain(const unsigned char* texels, int width, int height, int channels);
+
+// Read-only view of an archive written by BuildAssetPack. Everything handed out points
+// into the mapping and stays valid until Close. Lookups skip entries whose loose file
+// has changed since packing, so edits on disk win over a stale archive.
+class AssetPack {
+public:
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return file.IsOpen(); }
+
+    // name is the path the loaders use, e.g. "textures/cliff_side_diff_4k.jpg"
+    const PackEntry* FindEntry(const std::string& name, PackEntryType type) const;
+    const unsigned char* GetEntryData(const PackEntry& entry) const { return file.GetData() + entry.offset; }
+
+    size_t GetEntryCount() const { return entries.size(); }
+    size_t GetSize() const { return file.GetSize(); }
+
+private:
+    friend bool BuildAssetPack(const std::string& packPath, const std::vector<std::string>& roots);
+    const PackEntry* FindPacked(const std::string& name) const;
+
+    MappedFile file;
+    std::unordered_map<std::string, const PackEntry*> entries;
+};
+
+// the archive the loaders consult, opened once at startup; empty when there is none
+AssetPack& GetAssetPack();
+
+// offline packer: cooks every image, OBJ and shader under roots into packPath, copying
+// entries from the previous archive whose source content hash has not changed
+bool BuildAssetPack(const std::string& packPath, const std::vector<std::string>& roots);
+
+// loader lookup key for a path, so "./objs\\Tree.obj" and "objs/Tree.obj" match
+std::string NormalizeAssetName(const std::string& path);
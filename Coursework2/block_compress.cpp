@@ -0,0 +1,196 @@
+#include "block_compress.h"
+#include "asset_pack.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+uint16_t To565(const float color[3]) {
+    int r = std::clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = std::clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = std::clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void From565(uint16_t value, int out[3]) {
+    int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// nearest four-color palette entry for every pixel, returns the summed squared error
+int FitIndices(const int pixels[16][3], uint16_t c0, uint16_t c1, uint32_t& indices) {
+    int palette[4][3];
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    indices = 0;
+    int error = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestDistance = 1 << 30;
+        for (int p = 0; p < 4; p++) {
+            int dr = pixels[i][0] - palette[p][0], dg = pixels[i][1] - palette[p][1], db = pixels[i][2] - palette[p][2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= static_cast<uint32_t>(best) << (2 * i);
+        error += bestDistance;
+    }
+    return error;
+}
+
+// endpoints along the principal axis of the block's colors, then one least squares refit
+void EncodeBlock(const int pixels[16][3], unsigned char* out) {
+    float mean[3] = {};
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += pixels[i][c] / 16.0f;
+            lo[c] = std::min(lo[c], pixels[i][c]);
+            hi[c] = std::max(hi[c], pixels[i][c]);
+        }
+    }
+
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[3] = { pixels[i][0] - mean[0], pixels[i][1] - mean[1], pixels[i][2] - mean[2] };
+        for (int a = 0; a < 3; a++)
+            for (int b = 0; b < 3; b++)
+                covariance[a][b] += d[a] * d[b];
+    }
+
+    float axis[3] = { float(hi[0] - lo[0]), float(hi[1] - lo[1]), float(hi[2] - lo[2]) };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int a = 0; a < 3; a++)
+            next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+        float length = std::max({ std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2]) });
+        if (length < 1e-6f)
+            break;
+        for (int a = 0; a < 3; a++)
+            axis[a] = next[a] / length;
+    }
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (axisLength > 1e-6f) {
+        for (int a = 0; a < 3; a++)
+            axis[a] /= axisLength;
+    }
+
+    float tMin = 0.0f, tMax = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1] + (pixels[i][2] - mean[2]) * axis[2];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    // pull the ends in a little, the extremes are rarely worth a whole palette entry
+    float inset = (tMax - tMin) / 16.0f;
+    tMin += inset;
+    tMax -= inset;
+    float start[3], end[3];
+    for (int c = 0; c < 3; c++) {
+        start[c] = mean[c] + axis[c] * tMax;
+        end[c] = mean[c] + axis[c] * tMin;
+    }
+
+    uint16_t c0 = To565(start), c1 = To565(end);
+    if (c0 < c1)
+        std::swap(c0, c1);
+    uint32_t indices = 0;
+    int error = c0 == c1 ? 0 : FitIndices(pixels, c0, c1, indices);
+
+    if (c0 != c1) {
+        // weight of c0 for each index in four-color mode
+        static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = {}, bx[3] = {};
+        for (int i = 0; i < 16; i++) {
+            float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int c = 0; c < 3; c++) {
+                ax[c] += a * pixels[i][c];
+                bx[c] += b * pixels[i][c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) > 1e-6f) {
+            float refitStart[3], refitEnd[3];
+            for (int c = 0; c < 3; c++) {
+                refitStart[c] = (ax[c] * bb - bx[c] * ab) / det;
+                refitEnd[c] = (bx[c] * aa - ax[c] * ab) / det;
+            }
+            uint16_t r0 = To565(refitStart), r1 = To565(refitEnd);
+            if (r0 < r1)
+                std::swap(r0, r1);
+            uint32_t refitIndices;
+            if (r0 != r1) {
+                int refitError = FitIndices(pixels, r0, r1, refitIndices);
+                if (refitError < error) {
+                    c0 = r0;
+                    c1 = r1;
+                    indices = refitIndices;
+                }
+            }
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(c0 & 0xff);
+    out[1] = static_cast<unsigned char>(c0 >> 8);
+    out[2] = static_cast<unsigned char>(c1 & 0xff);
+    out[3] = static_cast<unsigned char>(c1 >> 8);
+    for (int b = 0; b < 4; b++)
+        out[4 + b] = static_cast<unsigned char>(indices >> (8 * b));
+}
+
+}
+
+GLenum GetBlockInternalFormat(BlockFormat format) {
+    return format == BlockFormat::BC7 ? GL_COMPRESSED_RGBA_BPTC_UNORM : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+const char* GetBlockFormatName(BlockFormat format) {
+    return format == BlockFormat::BC7 ? "BC7" : "BC1";
+}
+
+size_t GetCompressedSize(int width, int height, BlockFormat format) {
+    size_t blocks = size_t((width + 3) / 4) * size_t((height + 3) / 4);
+    return blocks * (format == BlockFormat::BC7 ? 16 : 8);
+}
+
+void CompressBC1(const unsigned char* texels, int width, int height, int channels, unsigned char* out) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int pixels[16][3];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            for (int py = 0; py < 4; py++) {
+                int y = std::min(by * 4 + py, height - 1);
+                for (int px = 0; px < 4; px++) {
+                    int x = std::min(bx * 4 + px, width - 1);
+                    const unsigned char* texel = texels + (size_t(y) * width + x) * channels;
+                    for (int c = 0; c < 3; c++)
+                        pixels[py * 4 + px][c] = texel[c];
+                }
+            }
+            EncodeBlock(pixels, out);
+            out += 8;
+        }
+    }
+}
+
+std::vector<std::vector<unsigned char>> CompressMipChainBC1(const unsigned char* chain, int width, int height, int channels) {
+    std::vector<std::vector<unsigned char>> levels;
+    for (const MipLevel& mip : GetMipLayout(width, height, channels)) {
+        levels.emplace_back(GetCompressedSize(mip.width, mip.height, BlockFormat::BC1));
+        CompressBC1(chain + mip.offset, mip.width, mip.height, channels, levels.back().data());
+    }
+    return levels;
+}
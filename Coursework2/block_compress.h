@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/gl3w.h>
+
+// 4x4 block compressed formats the texture cooker produces. BC1 has a CPU encoder here;
+// BC7 is only ever produced by the driver's encoder (see texture_cook.h).
+enum class BlockFormat : uint32_t {
+    BC1 = 1,        // 8 bytes per block, opaque RGB
+    BC7 = 2,        // 16 bytes per block, RGBA
+};
+
+GLenum GetBlockInternalFormat(BlockFormat format);
+const char* GetBlockFormatName(BlockFormat format);
+size_t GetCompressedSize(int width, int height, BlockFormat format);
+
+// encodes an opaque image (alpha ignored when channels is 4) into (w+3)/4 * (h+3)/4 BC1
+// blocks, row by row; edge blocks repeat the last row/column
+void CompressBC1(const unsigned char* texels, int width, int height, int channels, unsigned char* out);
+
+// every level of a GetMipLayout chain compressed to BC1, one buffer per level
+std::vector<std::vector<unsigned char>> CompressMipChainBC1(const unsigned char* chain, int width, int height, int channels);
@@ -0,0 +1,19 @@
+#include "frame_data.h"
+#include <cstring>
+
+void FrameDataBuffer::Init() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    buffer.Init(GL_UNIFORM_BUFFER, sizeof(FrameData), static_cast<size_t>(alignment));
+}
+
+void FrameDataBuffer::Update(const FrameData& data) {
+    void* region = buffer.Map(sizeof(FrameData));
+    std::memcpy(region, &data, sizeof(FrameData));
+    buffer.Unmap();
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, buffer.GetBuffer(), buffer.GetOffset(), sizeof(FrameData));
+}
+
+void FrameDataBuffer::Cleanup() {
+    buffer.Cleanup();
+}
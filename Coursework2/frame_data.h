@@ -0,0 +1,43 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <GL/gl3w.h>
+#include "stream_buffer.h"
+
+// uniform buffer binding point of the FrameData block; ShaderProgram::Load attaches every
+// program that declares the block to it
+const GLuint FRAME_DATA_BINDING = 0;
+// texture unit the shadow map stays bound to for the whole scene pass
+const GLuint SHADOW_MAP_UNIT = 1;
+
+// Camera, sun, shadow and fog values every scene shader reads, laid out as the std140 block
+// in shaders/frame_data.glsl. A vec3 there takes 16 bytes unless a float follows it, which
+// is why the members are ordered as they are.
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 viewProjection;
+    glm::mat4 inverseProjection;
+    glm::mat4 inverseView;
+    glm::mat4 lightSpaceMatrix;
+    glm::vec3 viewPos;
+    float sunElevation;
+    glm::vec3 lightDir;
+    float time;
+    glm::vec3 lightColor;
+    float fogDensity;
+    glm::vec3 fogColor;
+    float padding;
+};
+static_assert(sizeof(FrameData) == 448, "FrameData must match the std140 block");
+
+// the block's buffer, written once per frame into a stream buffer region and bound at
+// FRAME_DATA_BINDING from there
+class FrameDataBuffer {
+public:
+    void Init();
+    void Update(const FrameData& data);
+    void Cleanup();
+
+private:
+    StreamBuffer buffer;
+};
@@ -0,0 +1,20 @@
+#include "frustum.h"
+
+void Frustum::Extract(const glm::mat4& viewProjection) {
+    // each plane is the last row plus or minus one of the others (Gribb and Hartmann)
+    glm::mat4 rows = glm::transpose(viewProjection);
+    for (int i = 0; i < 3; i++) {
+        planes[i * 2] = rows[3] + rows[i];
+        planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::IsVisible(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
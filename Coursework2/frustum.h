@@ -0,0 +1,11 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// the six planes of a view-projection matrix, normals pointing inward, for culling
+// bounding spheres on the CPU; shaders/cull_regions.comp does the same on the GPU
+struct Frustum {
+    glm::vec4 planes[6];
+
+    void Extract(const glm::mat4& viewProjection);
+    bool IsVisible(const glm::vec3& center, float radius) const;
+};
@@ -0,0 +1,61 @@
+#include "gl_caps.h"
+#include <cstring>
+#include <iostream>
+
+static GLCaps caps;
+
+bool HasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool IsGLVersionAtLeast(int major, int minor) {
+    return caps.major > major || (caps.major == major && caps.minor >= minor);
+}
+
+void InitGLCaps() {
+    glGetIntegerv(GL_MAJOR_VERSION, &caps.major);
+    glGetIntegerv(GL_MINOR_VERSION, &caps.minor);
+
+    caps.multiDrawIndirect = IsGLVersionAtLeast(4, 3)
+        || (HasGLExtension("GL_ARB_multi_draw_indirect") && HasGLExtension("GL_ARB_base_instance"));
+    caps.textureCompressionS3TC = HasGLExtension("GL_EXT_texture_compression_s3tc");
+    caps.textureCompressionBPTC = IsGLVersionAtLeast(4, 2) || HasGLExtension("GL_ARB_texture_compression_bptc");
+    if (IsGLVersionAtLeast(4, 1) || HasGLExtension("GL_ARB_get_program_binary")) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        caps.programBinary = formats > 0;
+    }
+    caps.computeShader = IsGLVersionAtLeast(4, 3)
+        || (HasGLExtension("GL_ARB_compute_shader") && HasGLExtension("GL_ARB_shader_storage_buffer_object"));
+    caps.bufferStorage = IsGLVersionAtLeast(4, 4) || HasGLExtension("GL_ARB_buffer_storage");
+    bool khrParallel = HasGLExtension("GL_KHR_parallel_shader_compile");
+    caps.parallelShaderCompile = khrParallel || HasGLExtension("GL_ARB_parallel_shader_compile");
+    if (caps.parallelShaderCompile) {
+        // not in gl3w's core list; 0xFFFFFFFF lets the driver pick the thread count
+        typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+        auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(
+            gl3wGetProcAddress(khrParallel ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB"));
+        if (maxThreads)
+            maxThreads(0xFFFFFFFFu);
+    }
+
+    std::cout << "OpenGL " << caps.major << "." << caps.minor << " (" << glGetString(GL_RENDERER) << ")"
+        << ", multi-draw indirect: " << (caps.multiDrawIndirect ? "yes" : "no")
+        << ", BC1: " << (caps.textureCompressionS3TC ? "yes" : "no")
+        << ", BC7: " << (caps.textureCompressionBPTC ? "yes" : "no")
+        << ", program binaries: " << (caps.programBinary ? "yes" : "no")
+        << ", parallel shader compile: " << (caps.parallelShaderCompile ? "yes" : "no")
+        << ", compute shaders: " << (caps.computeShader ? "yes" : "no")
+        << ", buffer storage: " << (caps.bufferStorage ? "yes" : "no") << "\n";
+}
+
+const GLCaps& GetGLCaps() {
+    return caps;
+}
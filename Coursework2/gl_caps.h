@@ -0,0 +1,20 @@
+#pragma once
+#include <GL/gl3w.h>
+
+// optional features detected once after the context is created
+struct GLCaps {
+    int major = 3;
+    int minor = 3;
+    bool multiDrawIndirect = false;     // GL 4.3 or ARB_multi_draw_indirect + ARB_base_instance
+    bool textureCompressionS3TC = false;    // BC1, EXT_texture_compression_s3tc
+    bool textureCompressionBPTC = false;    // BC7, GL 4.2 or ARB_texture_compression_bptc
+    bool programBinary = false;     // GL 4.1 or ARB_get_program_binary, with at least one binary format
+    bool parallelShaderCompile = false;     // KHR_ or ARB_parallel_shader_compile
+    bool computeShader = false;     // GL 4.3 or ARB_compute_shader + ARB_shader_storage_buffer_object
+    bool bufferStorage = false;     // GL 4.4 or ARB_buffer_storage, for persistently mapped buffers
+};
+
+void InitGLCaps();
+const GLCaps& GetGLCaps();
+bool HasGLExtension(const char* name);
+bool IsGLVersionAtLeast(int major, int minor);
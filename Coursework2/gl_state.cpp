@@ -0,0 +1,150 @@
+#include "gl_state.h"
+
+namespace {
+
+// GL 3.3 guarantees 16 fragment texture units; the scene uses the first five
+const GLuint TRACKED_UNITS = 16;
+
+struct GLState {
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLuint activeUnit = 0;
+    GLuint textures2D[TRACKED_UNITS] = {};
+    GLuint textures2DArray[TRACKED_UNITS] = {};
+    bool depthTest = false;
+    bool blend = false;
+    bool depthClamp = false;
+    GLenum depthFunc = GL_LESS;
+    bool depthMask = true;
+    bool colorMask = true;
+    GLenum blendSource = GL_ONE;
+    GLenum blendDestination = GL_ZERO;
+};
+
+GLState state;
+GLStateStats stats;
+
+// true when the call has to be made
+template <typename T>
+bool Change(T& current, T value) {
+    if (current == value) {
+        stats.filtered++;
+        return false;
+    }
+    current = value;
+    stats.issued++;
+    return true;
+}
+
+GLuint* FindTextureSlot(GLuint unit, GLenum target) {
+    if (unit >= TRACKED_UNITS)
+        return nullptr;
+    if (target == GL_TEXTURE_2D)
+        return &state.textures2D[unit];
+    if (target == GL_TEXTURE_2D_ARRAY)
+        return &state.textures2DArray[unit];
+    return nullptr;
+}
+
+bool* FindCap(GLenum cap) {
+    switch (cap) {
+    case GL_DEPTH_TEST: return &state.depthTest;
+    case GL_BLEND: return &state.blend;
+    case GL_DEPTH_CLAMP: return &state.depthClamp;
+    default: return nullptr;
+    }
+}
+
+}
+
+void UseProgram(GLuint program) {
+    if (Change(state.program, program))
+        glUseProgram(program);
+}
+
+GLuint GetCurrentProgram() {
+    return state.program;
+}
+
+void BindVertexArray(GLuint vertexArray) {
+    if (Change(state.vertexArray, vertexArray))
+        glBindVertexArray(vertexArray);
+}
+
+void BindTexture(GLuint unit, GLenum target, GLuint texture) {
+    GLuint* slot = FindTextureSlot(unit, target);
+    if (slot && *slot == texture) {
+        stats.filtered++;
+        return;
+    }
+    if (Change(state.activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+    if (slot)
+        *slot = texture;
+    stats.issued++;
+    glBindTexture(target, texture);
+}
+
+void BindTextureToEdit(GLenum target, GLuint texture) {
+    if (Change(state.activeUnit, 0u))
+        glActiveTexture(GL_TEXTURE0);
+    BindTexture(0, target, texture);
+}
+
+void DeleteTexture(GLuint texture) {
+    // the name may come back from glGenTextures, so no unit may still claim it
+    for (GLuint unit = 0; unit < TRACKED_UNITS; unit++) {
+        if (state.textures2D[unit] == texture)
+            state.textures2D[unit] = 0;
+        if (state.textures2DArray[unit] == texture)
+            state.textures2DArray[unit] = 0;
+    }
+    glDeleteTextures(1, &texture);
+}
+
+void SetEnabled(GLenum cap, bool enabled) {
+    bool* current = FindCap(cap);
+    if (current && !Change(*current, enabled))
+        return;
+    if (!current)
+        stats.issued++;
+    if (enabled)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void SetDepthFunc(GLenum func) {
+    if (Change(state.depthFunc, func))
+        glDepthFunc(func);
+}
+
+void SetDepthMask(bool write) {
+    if (Change(state.depthMask, write))
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void SetColorMask(bool write) {
+    GLboolean value = write ? GL_TRUE : GL_FALSE;
+    if (Change(state.colorMask, write))
+        glColorMask(value, value, value, value);
+}
+
+void SetBlendFunc(GLenum source, GLenum destination) {
+    if (state.blendSource == source && state.blendDestination == destination) {
+        stats.filtered++;
+        return;
+    }
+    state.blendSource = source;
+    state.blendDestination = destination;
+    stats.issued++;
+    glBlendFunc(source, destination);
+}
+
+const GLStateStats& GetGLStateStats() {
+    return stats;
+}
+
+void ResetGLStateStats() {
+    stats = GLStateStats();
+}
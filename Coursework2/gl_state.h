@@ -0,0 +1,38 @@
+#pragma once
+#include <GL/gl3w.h>
+
+// Shadow copy of the GL state the scene changes every frame. Each setter compares with
+// what it last set and only calls GL when the value differs, so passes can bind what
+// they need without knowing what ran before them. It starts from the defaults of a new
+// context and only stays right if every program, vertex array and texture binding on
+// the GL thread goes through it; the offline tools in texture_cook.cpp, which never run
+// alongside the scene, are the exception.
+//
+// Deleting a bound texture or vertex array silently unbinds it: textures that go away
+// while frames are drawn are deleted with DeleteTexture, vertex arrays only at shutdown.
+
+void UseProgram(GLuint program);
+GLuint GetCurrentProgram();
+void BindVertexArray(GLuint vertexArray);
+// for sampling: makes unit current only when the binding has to change, so afterwards
+// any unit may be the active one
+void BindTexture(GLuint unit, GLenum target, GLuint texture);
+// for glTex* calls, which act on the active unit: binds on unit 0 and leaves it active
+void BindTextureToEdit(GLenum target, GLuint texture);
+void DeleteTexture(GLuint texture);
+
+// GL_DEPTH_TEST, GL_BLEND and GL_DEPTH_CLAMP are tracked; other caps go straight to GL
+void SetEnabled(GLenum cap, bool enabled);
+void SetDepthFunc(GLenum func);
+void SetDepthMask(bool write);
+void SetColorMask(bool write);
+void SetBlendFunc(GLenum source, GLenum destination);
+
+// state calls made and dropped as redundant since the last reset
+struct GLStateStats {
+    long long issued = 0;
+    long long filtered = 0;
+};
+
+const GLStateStats& GetGLStateStats();
+void ResetGLStateStats();
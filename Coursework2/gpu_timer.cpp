@@ -0,0 +1,46 @@
+#include "gpu_timer.h"
+
+void GpuTimer::Init(GLenum queryTarget) {
+    target = queryTarget;
+    glGenQueries(QUERY_COUNT, queries);
+}
+
+void GpuTimer::Begin() {
+    // collect the result this slot produced QUERY_COUNT frames ago
+    if (pending[current]) {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 result = 0;
+            glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &result);
+            total += static_cast<double>(result);
+            samples++;
+        }
+        pending[current] = false;
+    }
+
+    glBeginQuery(target, queries[current]);
+}
+
+void GpuTimer::End() {
+    glEndQuery(target);
+    pending[current] = true;
+    current = (current + 1) % QUERY_COUNT;
+}
+
+double GpuTimer::GetAverageMs() const {
+    return GetAverage() / 1000000.0;
+}
+
+double GpuTimer::GetAverage() const {
+    return samples > 0 ? total / samples : 0.0;
+}
+
+void GpuTimer::Reset() {
+    total = 0.0;
+    samples = 0;
+}
+
+void GpuTimer::Cleanup() {
+    glDeleteQueries(QUERY_COUNT, queries);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <GL/gl3w.h>
+
+// GL_TIME_ELAPSED timer that reads results a few frames late so it never stalls the pipeline.
+// Init with GL_SAMPLES_PASSED to count shaded fragments the same way.
+class GpuTimer {
+public:
+    void Init(GLenum target = GL_TIME_ELAPSED);
+    void Begin();
+    void End();
+    double GetAverageMs() const;
+    double GetAverage() const;
+    void Reset();
+    void Cleanup();
+
+private:
+    static const int QUERY_COUNT = 4;
+    GLenum target = GL_TIME_ELAPSED;
+    GLuint queries[QUERY_COUNT] = {};
+    bool pending[QUERY_COUNT] = {};
+    int current = 0;
+    double total = 0.0;
+    int samples = 0;
+};
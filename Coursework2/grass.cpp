@@ -0,0 +1,110 @@
+#include "grass.h"
+#include "shader.h"
+#include "frame_data.h"
+#include "gl_state.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include <iostream>
+
+void Grass::Init(int worldSize, Terrain& terrain) {
+    this->worldSize = worldSize;
+
+    // sample the terrain height once per grid vertex, matching the -0.5 offset of the terrain mesh
+    int size = worldSize + 1;
+    std::vector<float> heights(size * size);
+    for (int z = 0; z < size; ++z) {
+        for (int x = 0; x < size; ++x) {
+            heights[z * size + x] = terrain.GetTileHeight(float(x), float(z)) - 0.5f;
+        }
+    }
+
+    glGenTextures(1, &heightTexture);
+    BindTextureToEdit(GL_TEXTURE_2D, heightTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, heights.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // one instance per patch slot, blades are generated from gl_VertexID in the shader
+    patchCoords.assign(PATCH_GRID * PATCH_GRID, glm::ivec2(0));
+
+    glGenVertexArrays(1, &VAO);
+    BindVertexArray(VAO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+    BindVertexArray(0);
+    patchBuffer.Init(GL_ARRAY_BUFFER, patchCoords.size() * sizeof(glm::ivec2));
+    UploadPatches();
+
+    shader.Load("shaders/grass.vert", "shaders/grass.frag");
+    shader.Use();
+    shader.SetFloat(UniformId("patchSize"), PATCH_SIZE);
+    shader.SetFloat(UniformId("worldSize"), float(worldSize));
+    shader.SetInt(UniformId("bladesPerPatch"), BLADES_PER_PATCH);
+    shader.SetFloat(UniformId("fadeDistance"), PATCH_SIZE * PATCH_GRID * 0.5f);
+    shader.SetInt(UniformId("shadowMap"), SHADOW_MAP_UNIT);
+    shader.SetInt(UniformId("heightMap"), 4);
+
+    std::cout << "Grass: " << PATCH_GRID * PATCH_GRID << " patches, "
+        << PATCH_GRID * PATCH_GRID * BLADES_PER_PATCH << " blades\n";
+}
+
+void Grass::Update(const glm::vec3& playerPos) {
+    glm::ivec2 center = glm::ivec2(glm::floor(glm::vec2(playerPos.x, playerPos.z) / PATCH_SIZE));
+    if (center == centerPatch)
+        return;
+    centerPatch = center;
+
+    // toroidal window: each slot keeps its patch until it falls outside the window,
+    // then gets recycled to the patch that wrapped into its place on the other side
+    bool changed = false;
+    int half = PATCH_GRID / 2;
+    for (int sz = 0; sz < PATCH_GRID; ++sz) {
+        for (int sx = 0; sx < PATCH_GRID; ++sx) {
+            glm::ivec2 origin = center - glm::ivec2(half);
+            glm::ivec2 slot(sx, sz);
+            glm::ivec2 wanted = origin + ((slot - origin) % PATCH_GRID + PATCH_GRID) % PATCH_GRID;
+
+            int index = sz * PATCH_GRID + sx;
+            if (patchCoords[index] == wanted)
+                continue;
+
+            patchCoords[index] = wanted;
+            changed = true;
+        }
+    }
+
+    if (changed)
+        UploadPatches();
+}
+
+void Grass::UploadPatches() {
+    size_t size = patchCoords.size() * sizeof(glm::ivec2);
+    std::memcpy(patchBuffer.Map(size), patchCoords.data(), size);
+    patchBuffer.Unmap();
+
+    // the slot attribute follows the data to its new region
+    BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, patchBuffer.GetBuffer());
+    glVertexAttribIPointer(0, 2, GL_INT, sizeof(glm::ivec2), (void*)patchBuffer.GetOffset());
+    BindVertexArray(0);
+}
+
+void Grass::Submit(RenderQueue& queue) const {
+    DrawPacket packet;
+    packet.program = &shader;
+    packet.vertexArray = VAO;
+    packet.AddTexture(4, GL_TEXTURE_2D, heightTexture);
+    packet.count = BLADES_PER_PATCH * 3;
+    packet.instanceCount = PATCH_GRID * PATCH_GRID;
+    // the patches ring the player, right below the camera
+    queue.Add(RenderPass::Opaque, packet);
+}
+
+void Grass::Cleanup() {
+    glDeleteTextures(1, &heightTexture);
+    patchBuffer.Cleanup();
+    glDeleteVertexArrays(1, &VAO);
+    shader.Cleanup();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/gl3w.h>
+#include "terrain.h"
+#include "shader.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+
+// procedural ground cover drawn as a ring of instanced patches around the player
+class Grass {
+public:
+    void Init(int worldSize, Terrain& terrain);
+    void Update(const glm::vec3& playerPos);
+    // camera, sun and time come from the FrameData block, the shadow map from SHADOW_MAP_UNIT
+    void Submit(RenderQueue& queue) const;
+    void Cleanup();
+
+private:
+    void UploadPatches();
+
+    static const int PATCH_GRID = 32;           // patches per side of the recycled window
+    static const int BLADES_PER_PATCH = 1024;
+    static constexpr float PATCH_SIZE = 3.0f;
+
+    std::vector<glm::ivec2> patchCoords;        // world patch coordinate held by each slot
+    glm::ivec2 centerPatch = glm::ivec2(-100000);
+
+    GLuint VAO = 0;
+    StreamBuffer patchBuffer;                   // patchCoords, rewritten when the window moves
+    GLuint heightTexture = 0;
+    ShaderProgram shader;
+    int worldSize = 0;
+};
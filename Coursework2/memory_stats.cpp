@@ -0,0 +1,133 @@
+#include "memory_stats.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+std::atomic<size_t> allocations{ 0 };
+std::atomic<size_t> allocatedBytes{ 0 };
+std::atomic<size_t> liveBytes{ 0 };
+std::atomic<size_t> peakLiveBytes{ 0 };
+
+// the block size is kept in front of each allocation so delete can update liveBytes;
+// 16 bytes keeps the returned pointer at malloc's alignment
+const size_t HEADER_SIZE = 16;
+
+void* Allocate(size_t size) {
+    void* block = std::malloc(size + HEADER_SIZE);
+    if (!block)
+        return nullptr;
+    *static_cast<size_t*>(block) = size;
+
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return static_cast<char*>(block) + HEADER_SIZE;
+}
+
+void Free(void* ptr) {
+    if (!ptr)
+        return;
+    void* block = static_cast<char*>(ptr) - HEADER_SIZE;
+    liveBytes.fetch_sub(*static_cast<size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+double Megabytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+}
+
+void* operator new(size_t size) {
+    void* ptr = Allocate(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    Free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    Free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    Free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    Free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    Free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    Free(ptr);
+}
+
+MemoryStats GetMemoryStats() {
+    MemoryStats stats;
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed);
+    stats.liveBytes = liveBytes.load(std::memory_order_relaxed);
+    stats.peakLiveBytes = peakLiveBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+size_t GetPeakRSS() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void PrintMemoryReport(const char* label, const MemoryStats& since) {
+    MemoryStats now = GetMemoryStats();
+    std::cout << label << ": " << now.allocations - since.allocations << " allocations ("
+        << Megabytes(now.allocatedBytes - since.allocatedBytes) << " MB), live heap "
+        << Megabytes(now.liveBytes) << " MB, peak heap " << Megabytes(now.peakLiveBytes)
+        << " MB, peak RSS " << Megabytes(GetPeakRSS()) << " MB\n";
+}
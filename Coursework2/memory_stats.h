@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// process-wide heap counters, fed by the global operator new/delete in memory_stats.cpp
+struct MemoryStats {
+    size_t allocations = 0;     // operator new calls so far
+    size_t allocatedBytes = 0;  // total requested bytes so far
+    size_t liveBytes = 0;       // currently allocated
+    size_t peakLiveBytes = 0;   // high-water mark of liveBytes
+};
+
+MemoryStats GetMemoryStats();
+
+// peak resident set size of the process in bytes, 0 if the platform can't tell
+size_t GetPeakRSS();
+
+// prints "<label>: N allocations (X MB), peak heap Y MB, peak RSS Z MB" relative to since
+void PrintMemoryReport(const char* label, const MemoryStats& since = MemoryStats());
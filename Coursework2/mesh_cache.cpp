@@ -0,0 +1,309 @@
+#include "mesh_cache.h"
+#include "asset_pack.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+const uint32_t CACHE_VERSION = 3;
+const size_t CACHE_ALIGNMENT = 64;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t sourceTime;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint32_t segmentCount;
+    uint32_t reserved;
+};
+
+// offsets are from the start of the file and aligned to CACHE_ALIGNMENT
+struct CacheSegment {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t textureOffset;
+    uint32_t textureLength;
+    uint32_t indexSize;
+    uint32_t lodOffset;
+    uint32_t lodCount;
+    uint32_t reserved;
+};
+
+// index ranges are relative to the segment's index block
+struct CacheLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+    uint32_t reserved;
+};
+
+size_t AlignUp(size_t value) {
+    return (value + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+bool WriteCache(const std::string& cachePath, const std::vector<MeshSegment>& segments,
+    int64_t sourceTime, uint64_t sourceSize, uint64_t sourceHash) {
+    // write to a temporary name first so a half-written cache is never mapped
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out || !WriteMeshCacheImage(out, segments, sourceTime, sourceSize, sourceHash))
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+bool WriteMeshCacheImage(std::ostream& out, const std::vector<MeshSegment>& segments,
+    long long sourceTime, unsigned long long sourceSize, unsigned long long sourceHash) {
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.sourceTime = sourceTime;
+    header.sourceSize = sourceSize;
+    header.sourceHash = sourceHash;
+    header.segmentCount = static_cast<uint32_t>(segments.size());
+
+    // lay out: header, segment table, LOD table, strings, then aligned vertex/index blocks
+    std::vector<CacheSegment> table(segments.size());
+    std::vector<CacheLod> lodTable;
+    size_t offset = sizeof(CacheHeader) + table.size() * sizeof(CacheSegment);
+    for (size_t i = 0; i < segments.size(); i++) {
+        table[i].lodCount = static_cast<uint32_t>(segments[i].lods.size());
+        table[i].lodOffset = static_cast<uint32_t>(offset + lodTable.size() * sizeof(CacheLod));
+        for (const auto& lod : segments[i].lods)
+            lodTable.push_back({ lod.firstIndex, lod.indexCount, lod.error, 0 });
+    }
+    offset += lodTable.size() * sizeof(CacheLod);
+    for (size_t i = 0; i < segments.size(); i++) {
+        table[i].nameOffset = static_cast<uint32_t>(offset);
+        table[i].nameLength = static_cast<uint32_t>(segments[i].materialName.size());
+        offset += table[i].nameLength;
+        table[i].textureOffset = static_cast<uint32_t>(offset);
+        table[i].textureLength = static_cast<uint32_t>(segments[i].textureFile.size());
+        offset += table[i].textureLength;
+    }
+    for (size_t i = 0; i < segments.size(); i++) {
+        offset = AlignUp(offset);
+        table[i].vertexOffset = offset;
+        table[i].vertexCount = static_cast<uint32_t>(segments[i].vertices.size() / 8);
+        offset += segments[i].vertices.size() * sizeof(float);
+        offset = AlignUp(offset);
+        table[i].indexOffset = offset;
+        table[i].indexCount = static_cast<uint32_t>(segments[i].indices.size());
+        table[i].indexSize = table[i].vertexCount <= 65536 ? 2 : 4;
+        offset += segments[i].indices.size() * table[i].indexSize;
+    }
+
+    // offsets are relative to where the image starts in the stream
+    std::streamoff base = out.tellp();
+    const char padding[CACHE_ALIGNMENT] = {};
+    auto padTo = [&](uint64_t target) {
+        uint64_t pos = static_cast<uint64_t>(out.tellp() - base);
+        if (target > pos)
+            out.write(padding, static_cast<std::streamsize>(target - pos));
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(CacheSegment));
+    out.write(reinterpret_cast<const char*>(lodTable.data()), lodTable.size() * sizeof(CacheLod));
+    for (const auto& seg : segments) {
+        out.write(seg.materialName.data(), seg.materialName.size());
+        out.write(seg.textureFile.data(), seg.textureFile.size());
+    }
+    for (size_t i = 0; i < segments.size(); i++) {
+        padTo(table[i].vertexOffset);
+        out.write(reinterpret_cast<const char*>(segments[i].vertices.data()), segments[i].vertices.size() * sizeof(float));
+        padTo(table[i].indexOffset);
+        if (table[i].indexSize == 2) {
+            std::vector<uint16_t> narrow(segments[i].indices.begin(), segments[i].indices.end());
+            out.write(reinterpret_cast<const char*>(narrow.data()), narrow.size() * sizeof(uint16_t));
+        }
+        else {
+            out.write(reinterpret_cast<const char*>(segments[i].indices.data()), segments[i].indices.size() * sizeof(unsigned int));
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+void MeshCache::Load(const std::string& objPath) {
+    Release();
+    auto start = std::chrono::steady_clock::now();
+
+    // the packed archive holds the same image, served from its mapping
+    const AssetPack& pack = GetAssetPack();
+    if (const PackEntry* entry = pack.FindEntry(objPath, PackEntryType::Mesh)) {
+        if (ViewImage(pack.GetEntryData(*entry), static_cast<size_t>(entry->size))) {
+            std::cout << "Mesh cache: " << objPath << " served from asset pack in " << MillisecondsSince(start) << " ms ("
+                << segments.size() << " segments)\n";
+            return;
+        }
+        std::cerr << "Mesh cache: packed image of " << objPath << " is damaged, loading the OBJ\n";
+    }
+
+    std::error_code ec;
+    int64_t sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(objPath, ec).time_since_epoch().count());
+    uint64_t sourceSize = ec ? 0 : static_cast<uint64_t>(std::filesystem::file_size(objPath, ec));
+    std::string cachePath = objPath + ".meshcache";
+
+    if (!ec && MapCache(cachePath, sourceTime, sourceSize, objPath)) {
+        std::cout << "Mesh cache: " << objPath << " mapped in " << MillisecondsSince(start) << " ms ("
+            << segments.size() << " segments)\n";
+        return;
+    }
+
+    parsed = LoadMeshByMaterial(objPath);
+    double parseMs = MillisecondsSince(start);
+
+    uint64_t sourceHash = 0;
+    if (!ec && HashFile(objPath, sourceHash) && WriteCache(cachePath, parsed, sourceTime, sourceSize, sourceHash)
+        && MapCache(cachePath, sourceTime, sourceSize, objPath)) {
+        parsed.clear();
+        parsed.shrink_to_fit();
+    }
+    else {
+        std::cerr << "Mesh cache: could not write " << cachePath << ", using parsed data\n";
+        BuildViews(parsed);
+    }
+
+    std::cout << "Mesh cache: " << objPath << " parsed in " << parseMs << " ms, rebuilt cache in "
+        << MillisecondsSince(start) - parseMs << " ms\n";
+}
+
+bool MeshCache::MapCache(const std::string& cachePath, long long sourceTime, unsigned long long sourceSize, const std::string& objPath) {
+    if (!file.Open(cachePath))
+        return false;
+
+    const unsigned char* base = file.GetData();
+    size_t size = file.GetSize();
+    CacheHeader header;
+    if (size < sizeof(header)) {
+        file.Close();
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+
+    if (std::memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != CACHE_VERSION
+        || header.sourceSize != sourceSize
+        || sizeof(CacheHeader) + header.segmentCount * sizeof(CacheSegment) > size) {
+        file.Close();
+        return false;
+    }
+
+    // same size but touched: only a content hash mismatch invalidates the cache
+    if (header.sourceTime != sourceTime) {
+        uint64_t sourceHash = 0;
+        if (!HashFile(objPath, sourceHash) || sourceHash != header.sourceHash) {
+            file.Close();
+            return false;
+        }
+
+        // record the new mtime so the next start skips the hash
+        file.Close();
+        header.sourceTime = sourceTime;
+        std::fstream patch(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+        patch.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        patch.close();
+        if (!file.Open(cachePath))
+            return false;
+        base = file.GetData();
+        size = file.GetSize();
+    }
+
+    if (!ViewImage(base, size)) {
+        file.Close();
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::ViewImage(const unsigned char* base, size_t size) {
+    CacheHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != CACHE_VERSION
+        || sizeof(CacheHeader) + header.segmentCount * sizeof(CacheSegment) > size)
+        return false;
+
+    const CacheSegment* table = reinterpret_cast<const CacheSegment*>(base + sizeof(CacheHeader));
+    for (uint32_t i = 0; i < header.segmentCount; i++) {
+        const CacheSegment& entry = table[i];
+        if (entry.vertexOffset + entry.vertexCount * 8ull * sizeof(float) > size
+            || (entry.indexSize != 2 && entry.indexSize != 4)
+            || entry.indexOffset + entry.indexCount * 1ull * entry.indexSize > size
+            || entry.nameOffset + entry.nameLength > size || entry.textureOffset + entry.textureLength > size
+            || entry.lodOffset + entry.lodCount * 1ull * sizeof(CacheLod) > size) {
+            segments.clear();
+            return false;
+        }
+
+        MeshSegmentView view;
+        view.vertices = reinterpret_cast<const float*>(base + entry.vertexOffset);
+        view.vertexCount = entry.vertexCount;
+        view.indices = base + entry.indexOffset;
+        view.indexCount = entry.indexCount;
+        view.indexSize = entry.indexSize;
+        view.materialName.assign(reinterpret_cast<const char*>(base + entry.nameOffset), entry.nameLength);
+        view.textureFile.assign(reinterpret_cast<const char*>(base + entry.textureOffset), entry.textureLength);
+
+        const CacheLod* lods = reinterpret_cast<const CacheLod*>(base + entry.lodOffset);
+        for (uint32_t l = 0; l < entry.lodCount; l++) {
+            if (uint64_t(lods[l].firstIndex) + lods[l].indexCount > entry.indexCount) {
+                segments.clear();
+                return false;
+            }
+            view.lods.push_back({ lods[l].firstIndex, lods[l].indexCount, lods[l].error });
+        }
+        if (view.lods.empty())
+            view.lods.push_back({ 0, entry.indexCount, 0.0f });
+        segments.push_back(view);
+    }
+    return true;
+}
+
+void MeshCache::BuildViews(const std::vector<MeshSegment>& source) {
+    segments.clear();
+    for (const auto& seg : source) {
+        MeshSegmentView view;
+        view.vertices = seg.vertices.data();
+        view.vertexCount = static_cast<unsigned int>(seg.vertices.size() / 8);
+        view.indices = seg.indices.data();
+        view.indexCount = static_cast<unsigned int>(seg.indices.size());
+        view.materialName = seg.materialName;
+        view.textureFile = seg.textureFile;
+        view.lods = seg.lods;
+        if (view.lods.empty())
+            view.lods.push_back({ 0, view.indexCount, 0.0f });
+        segments.push_back(view);
+    }
+}
+
+void MeshCache::Release() {
+    segments.clear();
+    parsed.clear();
+    parsed.shrink_to_fit();
+    file.Close();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+// one material segment pointing straight into the cache mapping (or into parsed data
+// when the cache could not be written); pointers stay valid until Release
+struct MeshSegmentView {
+    const float* vertices = nullptr;    // interleaved position(3) texcoord(2) normal(3)
+    unsigned int vertexCount = 0;
+    const void* indices = nullptr;
+    unsigned int indexCount = 0;        // every level of detail, back to back
+    unsigned int indexSize = 4;         // 2 when every index fits in 16 bits
+    std::vector<MeshLod> lods;          // ranges of indices, finest first
+    std::string materialName;
+    std::string textureFile;
+
+    unsigned int Index(unsigned int i) const {
+        return indexSize == 2 ? static_cast<const unsigned short*>(indices)[i] : static_cast<const unsigned int*>(indices)[i];
+    }
+};
+
+// Binary copy of an OBJ's indexed per-material segments, stored next to the source as
+// <obj>.meshcache. The cache is rebuilt when the source size/mtime and content hash
+// no longer match, and loaded by mapping the file so data can go straight to glBufferData.
+// An OBJ packed into the asset archive is served from the archive's mapping instead.
+class MeshCache {
+public:
+    void Load(const std::string& objPath);
+    const std::vector<MeshSegmentView>& GetSegments() const { return segments; }
+    void Release();
+
+private:
+    bool MapCache(const std::string& cachePath, long long sourceTime, unsigned long long sourceSize, const std::string& objPath);
+    bool ViewImage(const unsigned char* base, size_t size);
+    void BuildViews(const std::vector<MeshSegment>& source);
+
+    MappedFile file;
+    std::vector<MeshSegment> parsed;
+    std::vector<MeshSegmentView> segments;
+};
+
+// the cache file layout written at the stream's current position, offsets relative to it;
+// the asset packer embeds the same image
+bool WriteMeshCacheImage(std::ostream& out, const std::vector<MeshSegment>& segments,
+    long long sourceTime, unsigned long long sourceSize, unsigned long long sourceHash);
@@ -0,0 +1,332 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+
+namespace {
+
+const int FORSYTH_CACHE_SIZE = 32;
+
+float ForsythVertexScore(int cachePosition, unsigned int remainingTriangles) {
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the last triangle's vertices get a fixed score so it isn't immediately reused
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+
+    // favour vertices with few triangles left so they leave the working set
+    score += 2.0f / std::sqrt(float(remainingTriangles));
+    return score;
+}
+
+// FIFO cache simulation shared by the ACMR and overdraw passes, returns misses for one triangle
+struct FifoCache {
+    std::pmr::vector<unsigned int> timestamps;
+    unsigned int time;
+    int size;
+
+    FifoCache(unsigned int vertexCount, int cacheSize, std::pmr::memory_resource* scratch)
+        : timestamps(vertexCount, 0, scratch), time(cacheSize + 1), size(cacheSize) {}
+
+    void Reset() { time += size + 1; }
+
+    unsigned int Add(const unsigned int* triangle) {
+        unsigned int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            if (time - timestamps[triangle[k]] > static_cast<unsigned int>(size)) {
+                timestamps[triangle[k]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+
+}
+
+void WeldVertices(std::vector<float>& vertices, std::vector<unsigned int>& indices, int floatsPerVertex, std::pmr::memory_resource* scratch) {
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    size_t stride = floatsPerVertex * sizeof(float);
+
+    // hash raw bytes so -0.0/0.0 and NaNs never weld together by accident
+    auto hashVertex = [&](unsigned int v) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&vertices[v * floatsPerVertex]);
+        size_t h = 1469598103934665603ull;
+        for (size_t i = 0; i < stride; i++)
+            h = (h ^ p[i]) * 1099511628211ull;
+        return h;
+    };
+
+    // open-addressed table of surviving vertices, sized up front so welding never allocates per vertex
+    const unsigned int empty = ~0u;
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2)
+        tableSize *= 2;
+    std::pmr::vector<unsigned int> table(tableSize, empty, scratch);
+    std::pmr::vector<unsigned int> remap(vertexCount, scratch);
+    unsigned int next = 0;
+
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        size_t slot = hashVertex(v) & (tableSize - 1);
+        while (table[slot] != empty
+            && std::memcmp(&vertices[table[slot] * floatsPerVertex], &vertices[v * floatsPerVertex], stride) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] != empty) {
+            remap[v] = table[slot];
+            continue;
+        }
+
+        // compact in place, survivors only ever move towards the front
+        if (next != v)
+            std::memmove(&vertices[next * floatsPerVertex], &vertices[v * floatsPerVertex], stride);
+        table[slot] = next;
+        remap[v] = next++;
+    }
+
+    vertices.resize(next * floatsPerVertex);
+    vertices.shrink_to_fit();
+    for (auto& index : indices)
+        index = remap[index];
+}
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::pmr::memory_resource* scratch) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles adjacency in one flat array
+    std::pmr::vector<unsigned int> remaining(vertexCount, 0, scratch);
+    for (unsigned int index : indices)
+        remaining[index]++;
+
+    std::pmr::vector<unsigned int> offsets(vertexCount + 1, 0, scratch);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::pmr::vector<unsigned int> adjacency(indices.size(), scratch);
+    std::pmr::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1, scratch);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+    }
+
+    std::pmr::vector<int> cachePosition(vertexCount, -1, scratch);
+    std::pmr::vector<float> vertexScore(vertexCount, scratch);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        vertexScore[v] = ForsythVertexScore(-1, remaining[v]);
+
+    std::pmr::vector<float> triangleScore(triangleCount, scratch);
+    std::pmr::vector<unsigned char> emitted(triangleCount, 0, scratch);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::pmr::vector<unsigned int> result(scratch);
+    result.reserve(indices.size());
+    std::pmr::vector<unsigned int> cache(scratch), nextCache(scratch);
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t scanCursor = 0;
+    long long best = 0;
+    for (size_t t = 1; t < triangleCount; t++) {
+        if (triangleScore[t] > triangleScore[best])
+            best = static_cast<long long>(t);
+    }
+
+    while (best >= 0) {
+        const unsigned int* tri = &indices[best * 3];
+        emitted[best] = 1;
+        result.insert(result.end(), tri, tri + 3);
+
+        // this triangle no longer counts towards its vertices' valence
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, static_cast<unsigned int>(best)), end - 1);
+            remaining[v]--;
+        }
+
+        // LRU update: the new triangle goes in front, the overflow falls out
+        nextCache.assign(tri, tri + 3);
+        for (unsigned int v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache.push_back(v);
+        }
+        for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++)
+            cachePosition[nextCache[i]] = -1;
+        if (nextCache.size() > FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+
+        for (size_t i = 0; i < cache.size(); i++)
+            cachePosition[cache[i]] = static_cast<int>(i);
+
+        // evicted vertices lost their cache bonus
+        for (unsigned int v : nextCache) {
+            if (cachePosition[v] != -1)
+                continue;
+            float newScore = ForsythVertexScore(-1, remaining[v]);
+            float delta = newScore - vertexScore[v];
+            vertexScore[v] = newScore;
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+                triangleScore[adjacency[a]] += delta;
+        }
+
+        // rescore the cached vertices, then pick the best triangle that touches one
+        for (unsigned int v : cache) {
+            float newScore = ForsythVertexScore(cachePosition[v], remaining[v]);
+            float delta = newScore - vertexScore[v];
+            vertexScore[v] = newScore;
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+                triangleScore[adjacency[a]] += delta;
+        }
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                unsigned int t = adjacency[a];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        // nothing adjacent left: fall back to the next unemitted triangle
+        if (best < 0) {
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            if (scanCursor < triangleCount)
+                best = static_cast<long long>(scanCursor);
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, int floatsPerVertex, float threshold, std::pmr::memory_resource* scratch) {
+    size_t triangleCount = indices.size() / 3;
+    unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / floatsPerVertex);
+    if (triangleCount < 2)
+        return;
+
+    // hard boundaries: the cache has fully turned over, reordering there costs nothing
+    FifoCache cache(vertexCount, 16, scratch);
+    std::pmr::vector<size_t> hard(scratch);
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (cache.Add(&indices[t * 3]) == 3)
+            hard.push_back(t);
+    }
+    if (hard.empty() || hard[0] != 0)
+        hard.insert(hard.begin(), 0);
+    hard.push_back(triangleCount);
+
+    // soft boundaries: split further wherever the running ACMR is within the threshold
+    std::pmr::vector<size_t> clusters(scratch);
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        size_t start = hard[h], end = hard[h + 1];
+
+        cache.Reset();
+        unsigned int clusterMisses = 0;
+        for (size_t t = start; t < end; t++)
+            clusterMisses += cache.Add(&indices[t * 3]);
+        float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+        cache.Reset();
+        unsigned int misses = 0;
+        size_t clusterStart = start;
+        clusters.push_back(start);
+        for (size_t t = start; t < end; t++) {
+            misses += cache.Add(&indices[t * 3]);
+            if (t + 1 < end && float(misses) / float(t - clusterStart + 1) <= clusterThreshold) {
+                clusters.push_back(t + 1);
+                clusterStart = t + 1;
+                misses = 0;
+                cache.Reset();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    auto position = [&](unsigned int v) {
+        const float* p = &vertices[v * floatsPerVertex];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    glm::vec3 meshCenter(0.0f);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        meshCenter += position(v);
+    meshCenter /= float(vertexCount);
+
+    // clusters facing away from the middle of the mesh are likely to occlude the rest
+    struct Cluster { size_t start, end; float sortKey; };
+    std::pmr::vector<Cluster> sorted(scratch);
+    sorted.reserve(clusters.size() - 1);
+    for (size_t c = 0; c + 1 < clusters.size(); c++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), d = position(indices[t * 3 + 2]);
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float triArea = glm::length(n);
+            centroid += (a + b + d) * (triArea / 3.0f);
+            normal += n;
+            area += triArea;
+        }
+        float normalLength = glm::length(normal);
+        float key = 0.0f;
+        if (area > 0.0f && normalLength > 0.0f)
+            key = glm::dot(centroid / area - meshCenter, normal / normalLength);
+        sorted.push_back({ clusters[c], clusters[c + 1], key });
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::pmr::vector<unsigned int> result(scratch);
+    result.reserve(indices.size());
+    for (const auto& cluster : sorted)
+        result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void OptimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, int floatsPerVertex, std::pmr::memory_resource* scratch) {
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    const unsigned int unused = ~0u;
+    std::pmr::vector<unsigned int> remap(vertexCount, unused, scratch);
+    std::pmr::vector<float> result(scratch);
+    result.reserve(vertices.size());
+
+    unsigned int next = 0;
+    for (auto& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+            result.insert(result.end(), vertices.begin() + index * floatsPerVertex, vertices.begin() + (index + 1) * floatsPerVertex);
+        }
+        index = remap[index];
+    }
+    std::copy(result.begin(), result.end(), vertices.begin());
+}
+
+float ComputeACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, int cacheSize, std::pmr::memory_resource* scratch) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return 0.0f;
+
+    FifoCache cache(vertexCount, cacheSize, scratch);
+    unsigned int misses = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+        misses += cache.Add(&indices[t * 3]);
+    return float(misses) / float(triangleCount);
+}
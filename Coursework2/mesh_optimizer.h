@@ -0,0 +1,28 @@
+#pragma once
+#include <memory_resource>
+#include <vector>
+
+// Index buffer post-processing for loaded meshes. Vertices are interleaved floats,
+// position first; every function keeps triangles intact. Temporaries come from
+// scratch, so a load can pass one arena and reset it between meshes.
+
+// merge bit-identical vertices, rewriting the index list to point at the survivors
+void WeldVertices(std::vector<float>& vertices, std::vector<unsigned int>& indices, int floatsPerVertex,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// Forsyth's linear-speed reordering of triangles for post-transform vertex cache hits
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// split the cache-ordered list into clusters and draw outward-facing ones first,
+// accepting up to threshold x the cluster's ACMR (Sander et al., "Tipsify")
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, int floatsPerVertex, float threshold,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// renumber vertices in first-use order so fetches walk the vertex buffer linearly
+void OptimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, int floatsPerVertex,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// average cache misses per triangle with a FIFO post-transform cache
+float ComputeACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, int cacheSize = 16,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
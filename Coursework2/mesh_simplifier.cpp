@@ -0,0 +1,428 @@
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <glm/glm.hpp>
+
+namespace {
+
+const int MAX_LOD_LEVELS = 4;
+const float LOD_LEVEL_ERROR = 0.05f;        // per level, relative to the mesh extent
+const float LOD_MIN_REDUCTION = 0.85f;      // a level has to drop at least 15% of the triangles
+const size_t LOD_MIN_TRIANGLES = 8;
+
+// symmetric 4x4 plane quadric (upper triangle) plus the area it was accumulated over
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    void AddPlane(const glm::dvec3& n, double d, double w) {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+        a22 += w * n.z * n.z; a23 += w * n.z * d;
+        a33 += w * d * d;
+        weight += w;
+    }
+
+    void Add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        weight += q.weight;
+    }
+};
+
+// area-weighted mean squared distance from p to the planes of both quadrics
+double CollapseCost(const Quadric& a, const Quadric& b, const glm::vec3& point) {
+    double x = point.x, y = point.y, z = point.z;
+    double r = 0.0;
+    for (const Quadric* q : { &a, &b }) {
+        r += q->a00 * x * x + 2.0 * q->a01 * x * y + 2.0 * q->a02 * x * z + 2.0 * q->a03 * x
+            + q->a11 * y * y + 2.0 * q->a12 * y * z + 2.0 * q->a13 * y
+            + q->a22 * z * z + 2.0 * q->a23 * z
+            + q->a33;
+    }
+    double weight = a.weight + b.weight;
+    return weight > 0.0 ? std::max(r, 0.0) / weight : 0.0;
+}
+
+struct Collapse {
+    unsigned int from;
+    unsigned int to;
+    float cost;
+};
+
+size_t TableSize(size_t count) {
+    size_t size = 1;
+    while (size < count * 2)
+        size *= 2;
+    return size;
+}
+
+uint64_t MixKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return key;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+float GetMeshExtent(const std::vector<float>& vertices, int floatsPerVertex) {
+    glm::vec3 minP(1e30f), maxP(-1e30f);
+    for (size_t v = 0; v + 3 <= vertices.size(); v += floatsPerVertex) {
+        glm::vec3 p(vertices[v], vertices[v + 1], vertices[v + 2]);
+        minP = glm::min(minP, p);
+        maxP = glm::max(maxP, p);
+    }
+    return vertices.empty() ? 0.0f : glm::length(maxP - minP);
+}
+
+void SimplifyMesh(std::vector<unsigned int>& destination, const std::vector<unsigned int>& indices,
+    const std::vector<float>& vertices, int floatsPerVertex, size_t targetIndexCount, float targetError,
+    float* resultError, std::pmr::memory_resource* scratch) {
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    if (resultError)
+        *resultError = 0.0f;
+
+    // positions scaled into a unit box so errors are relative to the mesh size
+    float extent = GetMeshExtent(vertices, floatsPerVertex);
+    float invExtent = extent > 0.0f ? 1.0f / extent : 0.0f;
+    glm::vec3 minP(1e30f);
+    for (size_t v = 0; v < vertexCount; v++)
+        minP = glm::min(minP, glm::vec3(vertices[v * floatsPerVertex], vertices[v * floatsPerVertex + 1], vertices[v * floatsPerVertex + 2]));
+    std::pmr::vector<glm::vec3> positions(vertexCount, scratch);
+    for (size_t v = 0; v < vertexCount; v++) {
+        const float* p = &vertices[v * floatsPerVertex];
+        positions[v] = (glm::vec3(p[0], p[1], p[2]) - minP) * invExtent;
+    }
+
+    // vertices split by a UV or normal seam share a position id; those never move
+    const unsigned int empty = ~0u;
+    std::pmr::vector<unsigned int> positionTable(TableSize(vertexCount), empty, scratch);
+    std::pmr::vector<unsigned int> positionId(vertexCount, scratch);
+    std::pmr::vector<unsigned char> locked(vertexCount, 0, scratch);
+    std::pmr::vector<unsigned int> sharing(vertexCount, 0, scratch);
+    size_t positionMask = positionTable.size() - 1;
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        uint64_t bits[2] = {};
+        std::memcpy(bits, &vertices[v * floatsPerVertex], 3 * sizeof(float));
+        size_t slot = MixKey(bits[0] * 31 + bits[1]) & positionMask;
+        while (positionTable[slot] != empty
+            && std::memcmp(&vertices[positionTable[slot] * floatsPerVertex], &vertices[v * floatsPerVertex], 3 * sizeof(float)) != 0)
+            slot = (slot + 1) & positionMask;
+        if (positionTable[slot] == empty)
+            positionTable[slot] = v;
+        positionId[v] = positionTable[slot];
+        sharing[positionId[v]]++;
+    }
+
+    // an edge seen in one direction only is an open border (or a material boundary)
+    std::pmr::vector<uint64_t> edgeTable(TableSize(indices.size()), ~0ull, scratch);
+    size_t edgeMask = edgeTable.size() - 1;
+    auto edgeKey = [&](unsigned int a, unsigned int b) { return (uint64_t(positionId[a]) << 32) | positionId[b]; };
+    auto findEdge = [&](uint64_t key) {
+        size_t slot = MixKey(key) & edgeMask;
+        while (edgeTable[slot] != ~0ull && edgeTable[slot] != key)
+            slot = (slot + 1) & edgeMask;
+        return slot;
+    };
+    for (size_t i = 0; i < indices.size(); i++) {
+        size_t next = i % 3 == 2 ? i - 2 : i + 1;
+        edgeTable[findEdge(edgeKey(indices[i], indices[next]))] = edgeKey(indices[i], indices[next]);
+    }
+    std::pmr::vector<unsigned char> positionLocked(vertexCount, 0, scratch);
+    for (size_t i = 0; i < indices.size(); i++) {
+        size_t next = i % 3 == 2 ? i - 2 : i + 1;
+        if (edgeTable[findEdge(edgeKey(indices[next], indices[i]))] == ~0ull) {
+            positionLocked[positionId[indices[i]]] = 1;
+            positionLocked[positionId[indices[next]]] = 1;
+        }
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+        locked[v] = positionLocked[positionId[v]] || sharing[positionId[v]] > 1;
+
+    std::pmr::vector<Quadric> quadrics(vertexCount, scratch);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const glm::vec3& p0 = positions[indices[t]];
+        glm::dvec3 n = glm::cross(glm::dvec3(positions[indices[t + 1]] - p0), glm::dvec3(positions[indices[t + 2]] - p0));
+        double length = glm::length(n);
+        if (length == 0.0)
+            continue;
+        n /= length;
+        double d = -glm::dot(n, glm::dvec3(p0));
+        for (int k = 0; k < 3; k++)
+            quadrics[positionId[indices[t + k]]].AddPlane(n, d, length * 0.5);
+    }
+
+    std::pmr::vector<unsigned int> result(indices.begin(), indices.end(), scratch);
+    std::pmr::vector<unsigned int> remap(vertexCount, scratch);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        remap[v] = v;
+
+    std::pmr::vector<unsigned int> triangleOffsets(vertexCount + 1, scratch);
+    std::pmr::vector<unsigned int> fill(vertexCount, scratch);
+    std::pmr::vector<unsigned int> vertexTriangles(scratch);
+    std::pmr::vector<Collapse> collapses(scratch);
+    std::pmr::vector<unsigned char> touched(vertexCount, scratch);
+    std::pmr::vector<unsigned int> ringFrom(scratch), ringTo(scratch);
+    float limit = targetError * targetError;
+    float maxCost = 0.0f;
+    targetIndexCount = std::max<size_t>(targetIndexCount, 3);
+
+    // each pass collapses the cheapest edges whose neighbourhoods do not overlap
+    while (result.size() > targetIndexCount) {
+        size_t triangleCount = result.size() / 3;
+
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (unsigned int index : result)
+            triangleOffsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        vertexTriangles.resize(result.size());
+        std::copy(triangleOffsets.begin(), triangleOffsets.end() - 1, fill.begin());
+        for (size_t i = 0; i < result.size(); i++)
+            vertexTriangles[fill[result[i]]++] = static_cast<unsigned int>(i / 3);
+
+        // one candidate per edge, in its cheaper direction
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i++) {
+            unsigned int a = result[i];
+            unsigned int b = result[i % 3 == 2 ? i - 2 : i + 1];
+            if (a > b)
+                continue;   // interior edges show up once per direction; borders are locked at both ends
+            Collapse best = { 0, 0, -1.0f };
+            if (!locked[a])
+                best = { a, b, static_cast<float>(CollapseCost(quadrics[positionId[a]], quadrics[positionId[b]], positions[b])) };
+            if (!locked[b]) {
+                float cost = static_cast<float>(CollapseCost(quadrics[positionId[b]], quadrics[positionId[a]], positions[a]));
+                if (best.cost < 0.0f || cost < best.cost)
+                    best = { b, a, cost };
+            }
+            if (best.cost >= 0.0f && best.cost <= limit)
+                collapses.push_back(best);
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t removeTarget = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0, applied = 0;
+        for (const Collapse& collapse : collapses) {
+            if (removed >= std::max<size_t>(removeTarget, 1))
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // link condition: the only positions next to both ends are the far corners of the shared triangles
+            size_t shared = 0;
+            ringFrom.clear();
+            ringTo.clear();
+            for (unsigned int k = triangleOffsets[collapse.from]; k < triangleOffsets[collapse.from + 1]; k++) {
+                const unsigned int* tri = &result[vertexTriangles[k] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                    shared++;
+                for (int c = 0; c < 3; c++)
+                    if (tri[c] != collapse.from)
+                        ringFrom.push_back(positionId[tri[c]]);
+            }
+            for (unsigned int k = triangleOffsets[collapse.to]; k < triangleOffsets[collapse.to + 1]; k++) {
+                const unsigned int* tri = &result[vertexTriangles[k] * 3];
+                for (int c = 0; c < 3; c++)
+                    if (tri[c] != collapse.to)
+                        ringTo.push_back(positionId[tri[c]]);
+            }
+            std::sort(ringFrom.begin(), ringFrom.end());
+            ringFrom.erase(std::unique(ringFrom.begin(), ringFrom.end()), ringFrom.end());
+            std::sort(ringTo.begin(), ringTo.end());
+            ringTo.erase(std::unique(ringTo.begin(), ringTo.end()), ringTo.end());
+            size_t common = 0;
+            for (size_t x = 0, y = 0; x < ringFrom.size() && y < ringTo.size();) {
+                if (ringFrom[x] == ringTo[y]) { common++; x++; y++; }
+                else if (ringFrom[x] < ringTo[y]) x++;
+                else y++;
+            }
+            if (common > shared)
+                continue;
+
+            // reject collapses that fold a surviving triangle over
+            bool flips = false;
+            for (unsigned int k = triangleOffsets[collapse.from]; k < triangleOffsets[collapse.from + 1] && !flips; k++) {
+                const unsigned int* tri = &result[vertexTriangles[k] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int c = 0; c < 3; c++) {
+                    before[c] = positions[tri[c]];
+                    after[c] = tri[c] == collapse.from ? positions[collapse.to] : before[c];
+                }
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                float l0 = glm::length(n0), l1 = glm::length(n1);
+                flips = l1 == 0.0f || glm::dot(n0, n1) < 1e-2f * l0 * l1;
+            }
+            if (flips)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[positionId[collapse.to]].Add(quadrics[positionId[collapse.from]]);
+            for (unsigned int k = triangleOffsets[collapse.from]; k < triangleOffsets[collapse.from + 1]; k++) {
+                const unsigned int* tri = &result[vertexTriangles[k] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+            removed += shared;
+            applied++;
+            maxCost = std::max(maxCost, collapse.cost);
+        }
+        if (applied == 0)
+            break;
+
+        // drop the triangles that collapsed to a line
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            unsigned int a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    destination.assign(result.begin(), result.end());
+    if (resultError)
+        *resultError = std::sqrt(maxCost);
+}
+
+void BuildLodChain(MeshSegment& segment, std::pmr::memory_resource* scratch) {
+    segment.lods.assign(1, MeshLod());
+    segment.lods[0].indexCount = static_cast<unsigned int>(segment.indices.size());
+
+    unsigned int vertexCount = static_cast<unsigned int>(segment.vertices.size() / 8);
+    float extent = GetMeshExtent(segment.vertices, 8);
+    std::vector<unsigned int> source(segment.indices), level;
+    float error = 0.0f;
+
+    // each level starts from the one before, so the cost shrinks with the mesh
+    for (int l = 1; l < MAX_LOD_LEVELS; l++) {
+        size_t target = source.size() / 6 * 3;
+        if (target / 3 < LOD_MIN_TRIANGLES)
+            break;
+
+        float levelError = 0.0f;
+        SimplifyMesh(level, source, segment.vertices, 8, target, LOD_LEVEL_ERROR, &levelError, scratch);
+        if (level.size() > source.size() * LOD_MIN_REDUCTION)
+            break;
+        OptimizeVertexCache(level, vertexCount, scratch);
+
+        // errors add up along the chain, so each level's bound is the running sum
+        error += levelError * extent;
+        MeshLod lod;
+        lod.firstIndex = static_cast<unsigned int>(segment.indices.size());
+        lod.indexCount = static_cast<unsigned int>(level.size());
+        lod.error = error;
+        segment.indices.insert(segment.indices.end(), level.begin(), level.end());
+        segment.lods.push_back(lod);
+        source.swap(level);
+    }
+}
+
+void BuildLodChains(std::vector<MeshSegment>& segments, int threadCount) {
+    size_t threads = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(1, std::min(threads, segments.size()));
+
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        ScratchArena scratch;
+        for (size_t s = next++; s < segments.size(); s = next++) {
+            BuildLodChain(segments[s], &scratch);
+            scratch.Reset();
+        }
+    };
+    if (threads == 1) {
+        work();
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; i++)
+        workers.emplace_back(work);
+    for (auto& worker : workers)
+        worker.join();
+}
+
+int SelectLod(const std::vector<MeshLod>& lods, float scale, float distance, float pixelScale, float maxPixels) {
+    distance = std::max(distance, 1e-3f);
+    int level = 0;
+    for (size_t l = 1; l < lods.size(); l++) {
+        if (lods[l].error * scale / distance * pixelScale > maxPixels)
+            break;
+        level = static_cast<int>(l);
+    }
+    return level;
+}
+
+void RunSimplifyBenchmark(const std::string& path) {
+    std::vector<MeshSegment> segments = LoadMeshByMaterial(path, false);
+    size_t triangles = 0;
+    for (const auto& segment : segments)
+        triangles += segment.indices.size() / 3;
+    std::cout << "Simplify benchmark: " << path << " (" << triangles << " triangles, " << segments.size() << " segments)\n";
+    if (triangles == 0)
+        return;
+
+    ScratchArena scratch;
+    for (float ratio : { 0.5f, 0.25f, 0.1f }) {
+        auto start = std::chrono::steady_clock::now();
+        size_t kept = 0;
+        float worst = 0.0f;
+        for (const auto& segment : segments) {
+            std::vector<unsigned int> simplified;
+            float error = 0.0f;
+            size_t target = static_cast<size_t>(segment.indices.size() / 3 * ratio) * 3;
+            SimplifyMesh(simplified, segment.indices, segment.vertices, 8, target, 1.0f, &error, &scratch);
+            kept += simplified.size() / 3;
+            worst = std::max(worst, error);
+            scratch.Reset();
+        }
+        double ms = MillisecondsSince(start);
+        std::cout << "  target " << ratio * 100.0f << "%: " << ms << " ms, " << triangles / (ms / 1000.0) / 1e6
+            << " M input triangles/s, kept " << kept << " (" << 100.0 * kept / triangles << "%), error " << worst * 100.0f << "% of extent\n";
+    }
+
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threads = 1; threads <= std::max(hardwareThreads, 2u); threads *= 2) {
+        std::vector<MeshSegment> copies;
+        for (const auto& segment : segments) {
+            MeshSegment copy;
+            copy.vertices = segment.vertices;
+            copy.indices = segment.indices;
+            copies.push_back(std::move(copy));
+        }
+        auto start = std::chrono::steady_clock::now();
+        BuildLodChains(copies, static_cast<int>(threads));
+        double ms = MillisecondsSince(start);
+        size_t levels = 0;
+        for (const auto& copy : copies)
+            levels = std::max(levels, copy.lods.size());
+        std::cout << "  LOD chain x" << threads << ": " << ms << " ms, " << triangles / (ms / 1000.0) / 1e6
+            << " M input triangles/s, " << levels << " levels\n";
+    }
+    std::cout << "  (" << hardwareThreads << " hardware threads)\n";
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include "obj_loader.h"
+
+// Quadric error metric simplification (Garland & Heckbert) by half-edge collapse, so every
+// level indexes the original vertex buffer. Vertices on UV/normal seams (a position shared
+// by several vertices) and on open borders are locked; segments are simplified one material
+// at a time, so material boundaries are borders and never move.
+
+// simplify toward targetIndexCount, stopping early once the next collapse would exceed
+// targetError; errors are relative to the mesh's bounding box diagonal
+void SimplifyMesh(std::vector<unsigned int>& destination, const std::vector<unsigned int>& indices,
+    const std::vector<float>& vertices, int floatsPerVertex, size_t targetIndexCount, float targetError,
+    float* resultError = nullptr, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// bounding box diagonal, what SimplifyMesh's relative errors are measured against
+float GetMeshExtent(const std::vector<float>& vertices, int floatsPerVertex);
+
+// appends coarser levels to segment.indices, each about half the triangles of the one
+// before, and fills segment.lods; stops when a level no longer shrinks the mesh
+void BuildLodChain(MeshSegment& segment, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+// BuildLodChain for every segment, spread over threadCount threads (0 = one per hardware thread)
+void BuildLodChains(std::vector<MeshSegment>& segments, int threadCount = 0);
+
+// coarsest level whose error, projected at distance, stays under maxPixels; pixelScale is
+// projection[1][1] * viewportHeight / 2, the pixels covered by one unit at distance one
+int SelectLod(const std::vector<MeshLod>& lods, float scale, float distance, float pixelScale, float maxPixels = 1.0f);
+
+// --bench-simplify: triangles per second at a few target ratios, single and multi-threaded
+void RunSimplifyBenchmark(const std::string& path);
@@ -1,169 +1,158 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "obj_loader.h"
 #include "tiny_obj_loader.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_parser.h"
+#include "scratch_arena.h"
+#include <algorithm>
 #include <iostream>
-#include <unordered_map>
-
-std::vector<float> LoadMyObj(const std::string& inputfile) {
-    std::vector<float> vertices;
-
-    tinyobj::ObjReaderConfig reader_config;
-    reader_config.triangulate = true;
-
-    tinyobj::ObjReader reader;
-
-    if (!reader.ParseFromFile(inputfile, reader_config)) {
-        if (!reader.Error().empty()) {
-            std::cerr << "TinyObjReader: " << reader.Error();
-        }
-        exit(1);
-    }
-
-    if (!reader.Warning().empty()) {
-        std::cout << "TinyObjReader: " << reader.Warning();
-    }
-
-    const auto& attrib = reader.GetAttrib();
-    const auto& shapes = reader.GetShapes();
-
-    for (const auto& shape : shapes) {
-        for (const auto& idx : shape.mesh.indices) {
-            float vx = attrib.vertices[3 * idx.vertex_index + 0];
-            float vy = attrib.vertices[3 * idx.vertex_index + 1];
-            float vz = attrib.vertices[3 * idx.vertex_index + 2];
-            vertices.push_back(vx);
-            vertices.push_back(vy);
-            vertices.push_back(vz);
-        }
-    }
-
-    return vertices;
-
+#include <map>
+
+// running totals for the welding / reordering report printed per file
+struct OptimizeStats {
+    size_t corners = 0;
+    size_t vertices = 0;
+    size_t triangles = 0;
+    double missesBefore = 0.0;
+    double missesAfter = 0.0;
+};
+
+// weld, reorder for the vertex cache and overdraw, then lay vertices out in fetch order
+static void OptimizeMesh(std::vector<float>& vertices, std::vector<unsigned int>& indices, int floatsPerVertex, OptimizeStats& stats,
+    ScratchArena& scratch) {
+    stats.corners += indices.size();
+    WeldVertices(vertices, indices, floatsPerVertex, &scratch);
+
+    unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / floatsPerVertex);
+    size_t triangleCount = indices.size() / 3;
+    stats.missesBefore += ComputeACMR(indices, vertexCount, 16, &scratch) * triangleCount;
+
+    OptimizeVertexCache(indices, vertexCount, &scratch);
+    OptimizeOverdraw(indices, vertices, floatsPerVertex, 1.05f, &scratch);
+    OptimizeVertexFetch(vertices, indices, floatsPerVertex, &scratch);
+
+    stats.missesAfter += ComputeACMR(indices, vertexCount, 16, &scratch) * triangleCount;
+    stats.vertices += vertexCount;
+    stats.triangles += triangleCount;
 }
 
-std::vector<float> LoadMyObjWithNormals(const std::string& inputfile) {
-    std::vector<float> vertices;
-
-    tinyobj::ObjReaderConfig reader_config;
-    reader_config.triangulate = true;
-
-    tinyobj::ObjReader reader;
+static void PrintOptimizeStats(const std::string& inputfile, const OptimizeStats& stats) {
+    if (stats.triangles == 0)
+        return;
+    std::cout << "Mesh: " << inputfile << " " << stats.corners << " corners -> " << stats.vertices << " vertices, ACMR "
+        << stats.missesBefore / stats.triangles << " -> " << stats.missesAfter / stats.triangles << " (FIFO 16)\n";
+}
 
-    if (!reader.ParseFromFile(inputfile, reader_config)) {
-        if (!reader.Error().empty()) {
-            std::cerr << "TinyObjReader: " << reader.Error();
+// triangles per level summed over segments, a segment with fewer levels counting its coarsest
+static void PrintLodStats(const std::string& inputfile, const std::vector<MeshSegment>& segments) {
+    size_t levels = 0;
+    for (const auto& segment : segments)
+        levels = std::max(levels, segment.lods.size());
+    std::cout << "Mesh LODs: " << inputfile;
+    for (size_t l = 0; l < levels; l++) {
+        size_t triangles = 0;
+        float error = 0.0f;
+        for (const auto& segment : segments) {
+            const MeshLod& lod = segment.lods[std::min(l, segment.lods.size() - 1)];
+            triangles += lod.indexCount / 3;
+            error = std::max(error, lod.error);
         }
-        exit(1);
-    }
-
-    if (!reader.Warning().empty()) {
-        std::cout << "TinyObjReader: " << reader.Warning();
+        std::cout << (l == 0 ? " " : " -> ") << triangles;
+        if (l > 0)
+            std::cout << " (" << error << ")";
     }
+    std::cout << " triangles\n";
+}
 
-    const auto& attrib = reader.GetAttrib();
-    const auto& shapes = reader.GetShapes();
-
-    for (const auto& shape : shapes) {
-        for (const auto& idx : shape.mesh.indices) {
-            float vx = attrib.vertices[3 * idx.vertex_index + 0];
-            float vy = attrib.vertices[3 * idx.vertex_index + 1];
-            float vz = attrib.vertices[3 * idx.vertex_index + 2];
-
-            float nx = 0.0f;
-            float ny = 0.0f;
-            float nz = 0.0f;
-            if (idx.normal_index >= 0) {
-                nx = attrib.normals[3 * idx.normal_index + 0];
-                ny = attrib.normals[3 * idx.normal_index + 1];
-                nz = attrib.normals[3 * idx.normal_index + 2];
+std::vector<MeshSegment> LoadMeshByMaterial(const std::string& inputfile, bool buildLods) {
+    std::map<int, MeshSegment> segments;
+    {
+        // the threaded parser covers the triangle/quad files we ship, anything else goes through tinyobj
+        ObjData obj;
+        if (!ParseObjParallel(inputfile, "objs/", 0, obj)) {
+            obj = ObjData();
+            if (!ParseObjTinyobj(inputfile, "objs/", obj)) {
+                exit(1);
             }
-
-            vertices.push_back(vx);
-            vertices.push_back(vy);
-            vertices.push_back(vz);
-            vertices.push_back(nx);
-            vertices.push_back(ny);
-            vertices.push_back(nz);
         }
-    }
-
-    return vertices;
-}
-
-std::vector<MeshSegment> LoadMeshByMaterial(const std::string& inputfile) {
-    tinyobj::ObjReaderConfig config;
-    config.triangulate = true;
-    config.mtl_search_path = "objs/";
-
-    tinyobj::ObjReader reader;
-    if (!reader.ParseFromFile(inputfile, config)) {
-        std::cerr << "TinyObjReader: " << reader.Error() << std::endl;
-        exit(1);
-    }
-
-    if (!reader.Warning().empty()) {
-        std::cout << "TinyObjReader: " << reader.Warning() << std::endl;
-    }
-
-    const auto& attrib = reader.GetAttrib();
-    const auto& shapes = reader.GetShapes();
-    const auto& materials = reader.GetMaterials();
-
-    std::unordered_map<int, MeshSegment> segments;
 
-    for (const auto& shape : shapes) {
-        size_t index_offset = 0;
-
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
-            int fv = shape.mesh.num_face_vertices[f];
-            int materialID = shape.mesh.material_ids[f];
+        // size every segment up front so building them is one allocation per buffer
+        std::map<int, size_t> triangleCounts;
+        for (int materialID : obj.materialIds)
+            triangleCounts[materialID]++;
 
+        int materialCount = static_cast<int>(obj.materialNames.size());
+        for (const auto& kv : triangleCounts) {
+            int materialID = kv.first;
             MeshSegment& segment = segments[materialID];
-            segment.materialName = materialID >= 0 && materialID < materials.size()
-                ? materials[materialID].name
+            segment.materialName = materialID >= 0 && materialID < materialCount
+                ? obj.materialNames[materialID]
                 : "default";
-            segment.textureFile = materialID >= 0 && materialID < materials.size()
-                ? materials[materialID].diffuse_texname
+            segment.textureFile = materialID >= 0 && materialID < materialCount
+                ? obj.textureFiles[materialID]
                 : "";
+            segment.vertices.reserve(kv.second * 3 * 8);
+            segment.indices.reserve(kv.second * 3);
+        }
 
-            for (size_t v = 0; v < fv; v++) {
-                tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
+        MeshSegment* segment = nullptr;
+        int segmentMaterial = 0;
+        for (size_t t = 0; t < obj.materialIds.size(); t++) {
+            int materialID = obj.materialIds[t];
+            if (!segment || materialID != segmentMaterial) {
+                segment = &segments[materialID];
+                segmentMaterial = materialID;
+            }
 
-                float vx = attrib.vertices[3 * idx.vertex_index + 0];
-                float vy = attrib.vertices[3 * idx.vertex_index + 1];
-                float vz = attrib.vertices[3 * idx.vertex_index + 2];
+            for (size_t v = 0; v < 3; v++) {
+                const ObjCorner& idx = obj.corners[t * 3 + v];
+
+                float vx = obj.positions[3 * idx.vertex + 0];
+                float vy = obj.positions[3 * idx.vertex + 1];
+                float vz = obj.positions[3 * idx.vertex + 2];
 
                 float tx = 0.0f, ty = 0.0f;
-                if (idx.texcoord_index >= 0) {
-                    tx = attrib.texcoords[2 * idx.texcoord_index + 0];
-                    ty = attrib.texcoords[2 * idx.texcoord_index + 1];
+                if (idx.texcoord >= 0) {
+                    tx = obj.texcoords[2 * idx.texcoord + 0];
+                    ty = obj.texcoords[2 * idx.texcoord + 1];
                 }
 
                 float nx = 0.0f, ny = 0.0f, nz = 0.0f;
-                if (idx.normal_index >= 0) {
-                    nx = attrib.normals[3 * idx.normal_index + 0];
-                    ny = attrib.normals[3 * idx.normal_index + 1];
-                    nz = attrib.normals[3 * idx.normal_index + 2];
+                if (idx.normal >= 0) {
+                    nx = obj.normals[3 * idx.normal + 0];
+                    ny = obj.normals[3 * idx.normal + 1];
+                    nz = obj.normals[3 * idx.normal + 2];
                 }
 
-                segment.vertices.push_back(vx);
-                segment.vertices.push_back(vy);
-                segment.vertices.push_back(vz);
-                segment.vertices.push_back(tx);
-                segment.vertices.push_back(ty);
-                segment.vertices.push_back(nx);
-                segment.vertices.push_back(ny);
-                segment.vertices.push_back(nz);
-
+                const float vertex[8] = { vx, vy, vz, tx, ty, nx, ny, nz };
+                segment->vertices.insert(segment->vertices.end(), vertex, vertex + 8);
+                segment->indices.push_back(static_cast<unsigned int>(segment->indices.size()));
             }
-
-            index_offset += fv;
         }
     }
 
+    // one scratch arena serves every segment's optimizer temporaries
+    ScratchArena scratch;
+    OptimizeStats stats;
     std::vector<MeshSegment> result;
+    result.reserve(segments.size());
     for (auto& kv : segments) {
-        result.push_back(kv.second);
+        OptimizeMesh(kv.second.vertices, kv.second.indices, 8, stats, scratch);
+        result.push_back(std::move(kv.second));
+        scratch.Reset();
+    }
+    PrintOptimizeStats(inputfile, stats);
+
+    if (buildLods) {
+        BuildLodChains(result);
+        PrintLodStats(inputfile, result);
+    }
+    else {
+        for (auto& segment : result) {
+            segment.lods.assign(1, MeshLod());
+            segment.lods[0].indexCount = static_cast<unsigned int>(segment.indices.size());
+        }
     }
     return result;
 }
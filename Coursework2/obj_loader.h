@@ -3,15 +3,32 @@
 #pragma once
 #include <string>
 #include <vector>
+// one level of detail: a range of a segment's index list and how far, in model units,
+// its surface may sit from the full mesh
+struct MeshLod {
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;
+};
+
+// move-only so a segment's buffers are handed along the load path, never duplicated
 struct MeshSegment {
-    std::vector<float> vertices; 
+    std::vector<float> vertices;        // interleaved position(3) texcoord(2) normal(3)
+    std::vector<unsigned int> indices;  // every level of detail back to back, finest first
+    std::vector<MeshLod> lods;          // lods[0] is the full mesh
     std::string materialName;
-    std::string textureFile;      
+    std::string textureFile;
+
+    MeshSegment() = default;
+    MeshSegment(MeshSegment&&) = default;
+    MeshSegment& operator=(MeshSegment&&) = default;
+    MeshSegment(const MeshSegment&) = delete;
+    MeshSegment& operator=(const MeshSegment&) = delete;
 };
 
-std::vector<MeshSegment> LoadMeshByMaterial(const std::string& inputfile);
-std::vector<float> LoadMyObjWithNormals(const std::string& inputfile);
-std::vector<float> LoadMyObj(const std::string& inputfile);
+// welded, cache-optimized triangle lists: interleaved floats out, triangle indices in `indices`,
+// followed by a simplified LOD chain unless buildLods is false
+std::vector<MeshSegment> LoadMeshByMaterial(const std::string& inputfile, bool buildLods = true);
 struct Vertex {
 	float x, y, z;
 	float u, v;
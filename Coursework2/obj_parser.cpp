@@ -0,0 +1,627 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+#include "tiny_obj_loader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// chunks smaller than this are not worth a thread
+const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+inline bool IsBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Same arithmetic as tinyobj's tryParseDouble, so values match it bit for bit, but
+// working on a [first, last) range like from_chars instead of a NUL-terminated line copy.
+bool ParseDouble(const char* s, const char* last, double& result) {
+    if (s >= last)
+        return false;
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    char sign = '+';
+    char expSign = '+';
+    const char* curr = s;
+    int read = 0;
+    bool leadingDot = false;
+
+    if (*curr == '+' || *curr == '-') {
+        sign = *curr;
+        curr++;
+        if (curr != last && *curr == '.')
+            leadingDot = true;
+    }
+    else if (*curr == '.') {
+        leadingDot = true;
+    }
+    else if (*curr < '0' || *curr > '9') {
+        return false;
+    }
+
+    if (!leadingDot) {
+        while (curr != last && *curr >= '0' && *curr <= '9') {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*curr - '0');
+            curr++;
+            read++;
+        }
+        if (read == 0)
+            return false;
+    }
+
+    if (curr != last && *curr == '.') {
+        static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+        const int lutEntries = sizeof powLut / sizeof powLut[0];
+        curr++;
+        read = 1;
+        while (curr != last && *curr >= '0' && *curr <= '9') {
+            mantissa += static_cast<int>(*curr - '0') * (read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+            read++;
+            curr++;
+        }
+    }
+
+    if (curr != last && (*curr == 'e' || *curr == 'E')) {
+        curr++;
+        if (curr != last && (*curr == '+' || *curr == '-')) {
+            expSign = *curr;
+            curr++;
+        }
+        else if (curr == last || *curr < '0' || *curr > '9') {
+            return false;
+        }
+
+        read = 0;
+        while (curr != last && *curr >= '0' && *curr <= '9') {
+            if (exponent > 2147483647 / 10)
+                return false;
+            exponent = exponent * 10 + static_cast<int>(*curr - '0');
+            curr++;
+            read++;
+        }
+        exponent *= (expSign == '+' ? 1 : -1);
+        if (read == 0)
+            return false;
+    }
+
+    result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+}
+
+// tinyobj's parseReal: skip blanks, take the token up to the next blank, default if unparsable
+const char* ParseReal(const char* p, const char* lineEnd, float& value) {
+    while (p < lineEnd && IsBlank(*p))
+        p++;
+    const char* tokenEnd = p;
+    while (tokenEnd < lineEnd && !IsBlank(*tokenEnd) && *tokenEnd != '\r')
+        tokenEnd++;
+
+    double parsed = 0.0;
+    ParseDouble(p, tokenEnd, parsed);
+    value = static_cast<float>(parsed);
+    return tokenEnd;
+}
+
+// atoi followed by tinyobj's skip to the next '/', blank or '\r'
+const char* ParseIndex(const char* p, const char* lineEnd, int& value) {
+    bool negative = false;
+    const char* q = p;
+    if (q < lineEnd && (*q == '+' || *q == '-')) {
+        negative = *q == '-';
+        q++;
+    }
+    int result = 0;
+    while (q < lineEnd && *q >= '0' && *q <= '9') {
+        result = result * 10 + (*q - '0');
+        q++;
+    }
+    value = negative ? -result : result;
+
+    while (q < lineEnd && *q != '/' && !IsBlank(*q) && *q != '\r')
+        q++;
+    return q;
+}
+
+struct MaterialEvent {
+    size_t face;                // faces stored in the chunk before the usemtl line
+    std::string name;
+};
+
+// everything one worker pulls out of its slice of the file; indices are chunk-local
+// until the merge adds the attribute counts of the chunks before it
+struct ObjChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    size_t beginOffset = 0;
+
+    std::vector<float> positions, texcoords, normals;
+    std::vector<int> faceCorners;               // v, vt, vn per corner
+    std::vector<unsigned char> faceSizes;       // 3 or 4
+    std::vector<size_t> relativeSlots;          // faceCorners entries that came from negative indices
+    std::vector<MaterialEvent> materialEvents;
+    std::vector<std::string> mtllibLines;
+    size_t firstUsemtl = SIZE_MAX;              // file offsets, to check mtllib comes first
+    size_t lastMtllib = 0;
+    bool hasMtllib = false;
+    bool unsupported = false;
+
+    // filled in by the merge
+    size_t positionBase = 0, texcoordBase = 0, normalBase = 0, triangleBase = 0, triangleCount = 0;
+    int startMaterial = -1;
+};
+
+void ParseChunk(ObjChunk& chunk) {
+    const char* p = chunk.begin;
+    while (p < chunk.end && !chunk.unsupported) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+        const char* lineEnd = newline ? newline : chunk.end;
+        const char* next = newline ? newline + 1 : chunk.end;
+        const char* lineStart = p;
+        if (lineEnd > p && lineEnd[-1] == '\r')
+            lineEnd--;
+
+        while (p < lineEnd && IsBlank(*p))
+            p++;
+        if (p == lineEnd || *p == '#') {
+            p = next;
+            continue;
+        }
+
+        size_t remaining = lineEnd - p;
+        if (remaining >= 2 && p[0] == 'v' && IsBlank(p[1])) {
+            float x, y, z;
+            const char* q = ParseReal(p + 2, lineEnd, x);
+            q = ParseReal(q, lineEnd, y);
+            ParseReal(q, lineEnd, z);
+            chunk.positions.push_back(x);
+            chunk.positions.push_back(y);
+            chunk.positions.push_back(z);
+        }
+        else if (remaining >= 3 && p[0] == 'v' && p[1] == 'n' && IsBlank(p[2])) {
+            float x, y, z;
+            const char* q = ParseReal(p + 3, lineEnd, x);
+            q = ParseReal(q, lineEnd, y);
+            ParseReal(q, lineEnd, z);
+            chunk.normals.push_back(x);
+            chunk.normals.push_back(y);
+            chunk.normals.push_back(z);
+        }
+        else if (remaining >= 3 && p[0] == 'v' && p[1] == 't' && IsBlank(p[2])) {
+            float u, v;
+            const char* q = ParseReal(p + 3, lineEnd, u);
+            ParseReal(q, lineEnd, v);
+            chunk.texcoords.push_back(u);
+            chunk.texcoords.push_back(v);
+        }
+        else if (remaining >= 2 && p[0] == 'f' && IsBlank(p[1])) {
+            const char* q = p + 2;
+            while (q < lineEnd && IsBlank(*q))
+                q++;
+
+            size_t firstSlot = chunk.faceCorners.size();
+            size_t firstRelative = chunk.relativeSlots.size();
+            int cornerCount = 0;
+            const int counts[3] = {
+                static_cast<int>(chunk.positions.size() / 3),
+                static_cast<int>(chunk.texcoords.size() / 2),
+                static_cast<int>(chunk.normals.size() / 3)
+            };
+
+            // tinyobj's fixIndex: 1-based, 0 only allowed (as "none") for vt/vn, negative is relative
+            auto addIndex = [&](int raw, int attribute) {
+                if (raw > 0) {
+                    chunk.faceCorners.push_back(raw - 1);
+                    return true;
+                }
+                if (raw == 0) {
+                    chunk.faceCorners.push_back(-1);
+                    return attribute != 0;
+                }
+                chunk.relativeSlots.push_back(chunk.faceCorners.size());
+                chunk.faceCorners.push_back(counts[attribute] + raw);
+                return true;
+            };
+
+            bool ok = true;
+            while (ok && q < lineEnd && *q != '\r') {
+                int v = 0, vt = 0, vn = 0;
+                bool hasVt = false, hasVn = false;
+                q = ParseIndex(q, lineEnd, v);
+                if (q < lineEnd && *q == '/') {
+                    q++;
+                    if (q < lineEnd && *q == '/') {
+                        q = ParseIndex(q + 1, lineEnd, vn);
+                        hasVn = true;
+                    }
+                    else {
+                        q = ParseIndex(q, lineEnd, vt);
+                        hasVt = true;
+                        if (q < lineEnd && *q == '/') {
+                            q = ParseIndex(q + 1, lineEnd, vn);
+                            hasVn = true;
+                        }
+                    }
+                }
+
+                ok = addIndex(v, 0);
+                if (hasVt) {
+                    ok = ok && addIndex(vt, 1);
+                }
+                else {
+                    chunk.faceCorners.push_back(-1);
+                }
+                if (hasVn) {
+                    ok = ok && addIndex(vn, 2);
+                }
+                else {
+                    chunk.faceCorners.push_back(-1);
+                }
+                cornerCount++;
+
+                while (q < lineEnd && (IsBlank(*q) || *q == '\r'))
+                    q++;
+            }
+
+            if (!ok || cornerCount > 4) {
+                chunk.unsupported = true;
+            }
+            else if (cornerCount < 3) {
+                // tinyobj drops degenerate faces
+                chunk.faceCorners.resize(firstSlot);
+                chunk.relativeSlots.resize(firstRelative);
+            }
+            else {
+                chunk.faceSizes.push_back(static_cast<unsigned char>(cornerCount));
+            }
+        }
+        else if (remaining >= 6 && std::strncmp(p, "usemtl", 6) == 0) {
+            const char* q = p + 6;
+            while (q < lineEnd && IsBlank(*q))
+                q++;
+            const char* nameEnd = q;
+            while (nameEnd < lineEnd && !IsBlank(*nameEnd) && *nameEnd != '\r')
+                nameEnd++;
+            chunk.materialEvents.push_back({ chunk.faceSizes.size(), std::string(q, nameEnd) });
+            chunk.firstUsemtl = std::min(chunk.firstUsemtl, chunk.beginOffset + static_cast<size_t>(lineStart - chunk.begin));
+        }
+        else if (remaining >= 7 && std::strncmp(p, "mtllib", 6) == 0 && IsBlank(p[6])) {
+            chunk.mtllibLines.push_back(std::string(p + 7, lineEnd));
+            chunk.lastMtllib = chunk.beginOffset + static_cast<size_t>(lineStart - chunk.begin);
+            chunk.hasMtllib = true;
+        }
+
+        p = next;
+    }
+}
+
+// tinyobj's SplitString for mtllib lines, '\' escapes a space
+std::vector<std::string> SplitFilenames(const std::string& line) {
+    std::vector<std::string> names;
+    std::string token;
+    bool escaping = false;
+    for (char ch : line) {
+        if (escaping) {
+            escaping = false;
+        }
+        else if (ch == '\\') {
+            escaping = true;
+            continue;
+        }
+        else if (ch == ' ') {
+            if (!token.empty())
+                names.push_back(token);
+            token.clear();
+            continue;
+        }
+        token += ch;
+    }
+    names.push_back(token);
+    return names;
+}
+
+// vertex positions are needed to pick the quad diagonal, so this runs after every chunk is copied
+bool TriangulateChunk(const ObjChunk& chunk, const std::vector<std::pair<size_t, int>>& events, ObjData& out) {
+    const int limits[3] = {
+        static_cast<int>(out.positions.size() / 3),
+        static_cast<int>(out.texcoords.size() / 2),
+        static_cast<int>(out.normals.size() / 3)
+    };
+    const int bases[3] = {
+        static_cast<int>(chunk.positionBase),
+        static_cast<int>(chunk.texcoordBase),
+        static_cast<int>(chunk.normalBase)
+    };
+
+    size_t relative = 0;
+    size_t event = 0;
+    int material = chunk.startMaterial;
+    size_t triangle = chunk.triangleBase;
+    size_t slot = 0;
+    ObjCorner face[4];
+
+    for (size_t f = 0; f < chunk.faceSizes.size(); f++) {
+        while (event < events.size() && events[event].first <= f) {
+            material = events[event].second;
+            event++;
+        }
+
+        int cornerCount = chunk.faceSizes[f];
+        for (int c = 0; c < cornerCount; c++) {
+            int resolved[3];
+            for (int a = 0; a < 3; a++, slot++) {
+                int index = chunk.faceCorners[slot];
+                if (relative < chunk.relativeSlots.size() && chunk.relativeSlots[relative] == slot) {
+                    index += bases[a];
+                    relative++;
+                    if (index < 0)
+                        return false;
+                }
+                if (index >= limits[a] || (a == 0 && index < 0))
+                    return false;
+                resolved[a] = index;
+            }
+            face[c] = { resolved[0], resolved[1], resolved[2] };
+        }
+
+        ObjCorner* corners = &out.corners[triangle * 3];
+        if (cornerCount == 3) {
+            corners[0] = face[0];
+            corners[1] = face[1];
+            corners[2] = face[2];
+            out.materialIds[triangle++] = material;
+            continue;
+        }
+
+        // split along the shorter diagonal, exactly as tinyobj does
+        const float* v0 = &out.positions[face[0].vertex * 3];
+        const float* v1 = &out.positions[face[1].vertex * 3];
+        const float* v2 = &out.positions[face[2].vertex * 3];
+        const float* v3 = &out.positions[face[3].vertex * 3];
+        float e02x = v2[0] - v0[0], e02y = v2[1] - v0[1], e02z = v2[2] - v0[2];
+        float e13x = v3[0] - v1[0], e13y = v3[1] - v1[1], e13z = v3[2] - v1[2];
+        float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+        float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+        if (sqr02 < sqr13) {
+            corners[0] = face[0]; corners[1] = face[1]; corners[2] = face[2];
+            corners[3] = face[0]; corners[4] = face[2]; corners[5] = face[3];
+        }
+        else {
+            corners[0] = face[0]; corners[1] = face[1]; corners[2] = face[3];
+            corners[3] = face[1]; corners[4] = face[2]; corners[5] = face[3];
+        }
+        out.materialIds[triangle++] = material;
+        out.materialIds[triangle++] = material;
+    }
+    return true;
+}
+
+template <typename Function>
+void RunOnThreads(size_t count, Function function) {
+    if (count == 1) {
+        function(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < count; i++)
+        workers.emplace_back(function, i);
+    for (auto& worker : workers)
+        worker.join();
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+bool ParseObjTinyobj(const std::string& path, const std::string& mtlSearchPath, ObjData& out) {
+    tinyobj::ObjReaderConfig config;
+    config.triangulate = true;
+    config.mtl_search_path = mtlSearchPath;
+
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(path, config)) {
+        std::cerr << "TinyObjReader: " << reader.Error() << std::endl;
+        return false;
+    }
+
+    if (!reader.Warning().empty()) {
+        std::cout << "TinyObjReader: " << reader.Warning() << std::endl;
+    }
+
+    const auto& attrib = reader.GetAttrib();
+    out.positions = attrib.vertices;
+    out.texcoords = attrib.texcoords;
+    out.normals = attrib.normals;
+
+    for (const auto& shape : reader.GetShapes()) {
+        size_t indexOffset = 0;
+        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+            int fv = shape.mesh.num_face_vertices[f];
+            for (int v = 0; v < fv; v++) {
+                const tinyobj::index_t& idx = shape.mesh.indices[indexOffset + v];
+                out.corners.push_back({ idx.vertex_index, idx.texcoord_index, idx.normal_index });
+            }
+            out.materialIds.push_back(shape.mesh.material_ids[f]);
+            indexOffset += fv;
+        }
+    }
+
+    for (const auto& material : reader.GetMaterials()) {
+        out.materialNames.push_back(material.name);
+        out.textureFiles.push_back(material.diffuse_texname);
+    }
+    return true;
+}
+
+bool ParseObjParallel(const std::string& path, const std::string& mtlSearchPath, int threadCount, ObjData& out) {
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
+
+    const char* data = reinterpret_cast<const char*>(file.GetData());
+    size_t size = file.GetSize();
+
+    size_t threads = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(1, std::min(threads, size / MIN_CHUNK_BYTES));
+
+    // split at line starts so every line belongs to exactly one chunk
+    std::vector<ObjChunk> chunks(threads);
+    size_t start = 0;
+    for (size_t i = 0; i < threads; i++) {
+        size_t end = i + 1 == threads ? size : std::max(start, size * (i + 1) / threads);
+        if (end < size) {
+            const char* newline = static_cast<const char*>(std::memchr(data + end, '\n', size - end));
+            end = newline ? static_cast<size_t>(newline - data) + 1 : size;
+        }
+        chunks[i].begin = data + start;
+        chunks[i].end = data + end;
+        chunks[i].beginOffset = start;
+        start = end;
+    }
+
+    RunOnThreads(threads, [&](size_t i) { ParseChunk(chunks[i]); });
+
+    // prefix sums over attribute and triangle counts
+    size_t positionCount = 0, texcoordCount = 0, normalCount = 0, triangleCount = 0;
+    size_t firstUsemtl = SIZE_MAX, lastMtllib = 0;
+    bool hasMtllib = false;
+    for (auto& chunk : chunks) {
+        if (chunk.unsupported)
+            return false;
+
+        chunk.positionBase = positionCount / 3;
+        chunk.texcoordBase = texcoordCount / 2;
+        chunk.normalBase = normalCount / 3;
+        chunk.triangleBase = triangleCount;
+        for (unsigned char corners : chunk.faceSizes)
+            chunk.triangleCount += corners - 2;
+
+        positionCount += chunk.positions.size();
+        texcoordCount += chunk.texcoords.size();
+        normalCount += chunk.normals.size();
+        triangleCount += chunk.triangleCount;
+        firstUsemtl = std::min(firstUsemtl, chunk.firstUsemtl);
+        if (chunk.hasMtllib) {
+            lastMtllib = std::max(lastMtllib, chunk.lastMtllib);
+            hasMtllib = true;
+        }
+    }
+
+    // materials are resolved up front, so a library loaded after the first usemtl goes to tinyobj
+    if (hasMtllib && firstUsemtl != SIZE_MAX && lastMtllib > firstUsemtl)
+        return false;
+
+    std::vector<tinyobj::material_t> materials;
+    std::map<std::string, int> materialMap;
+    std::set<std::string> loadedFiles;
+    tinyobj::MaterialFileReader readMaterial(mtlSearchPath);
+    for (const auto& chunk : chunks) {
+        for (const auto& line : chunk.mtllibLines) {
+            for (const auto& filename : SplitFilenames(line)) {
+                if (loadedFiles.count(filename) > 0)
+                    continue;
+                std::string warn, err;
+                if (readMaterial(filename, &materials, &materialMap, &warn, &err)) {
+                    loadedFiles.insert(filename);
+                    break;
+                }
+            }
+        }
+    }
+
+    // the material in effect at each chunk start is whatever the previous chunk ended on
+    std::vector<std::vector<std::pair<size_t, int>>> events(threads);
+    int material = -1;
+    for (size_t i = 0; i < threads; i++) {
+        chunks[i].startMaterial = material;
+        for (const auto& event : chunks[i].materialEvents) {
+            auto it = materialMap.find(event.name);
+            material = it != materialMap.end() ? it->second : -1;
+            events[i].push_back({ event.face, material });
+        }
+    }
+
+    out.positions.resize(positionCount);
+    out.texcoords.resize(texcoordCount);
+    out.normals.resize(normalCount);
+    out.corners.resize(triangleCount * 3);
+    out.materialIds.resize(triangleCount);
+
+    RunOnThreads(threads, [&](size_t i) {
+        ObjChunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), out.positions.begin() + chunk.positionBase * 3);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), out.texcoords.begin() + chunk.texcoordBase * 2);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), out.normals.begin() + chunk.normalBase * 3);
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.texcoords);
+        std::vector<float>().swap(chunk.normals);
+    });
+
+    std::vector<char> valid(threads, 1);
+    RunOnThreads(threads, [&](size_t i) { valid[i] = TriangulateChunk(chunks[i], events[i], out); });
+    if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+        return false;
+
+    for (const auto& m : materials) {
+        out.materialNames.push_back(m.name);
+        out.textureFiles.push_back(m.diffuse_texname);
+    }
+    return true;
+}
+
+void RunObjParseBenchmark(const std::string& path) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        std::cerr << "OBJ benchmark: cannot open " << path << "\n";
+        return;
+    }
+    double megabytes = file.GetSize() / (1024.0 * 1024.0);
+    file.Close();
+
+    auto start = std::chrono::steady_clock::now();
+    ObjData reference;
+    if (!ParseObjTinyobj(path, "objs/", reference))
+        return;
+    double tinyobjMs = MillisecondsSince(start);
+    std::cout << "OBJ benchmark: " << path << " (" << megabytes << " MB, " << reference.corners.size() / 3 << " triangles)\n";
+    std::cout << "  tinyobj:     " << tinyobjMs << " ms, " << megabytes / (tinyobjMs / 1000.0) << " MB/s\n";
+
+    auto same = [](const ObjData& a, const ObjData& b) {
+        auto sameFloats = [](const std::vector<float>& x, const std::vector<float>& y) {
+            return x.size() == y.size() && (x.empty() || std::memcmp(x.data(), y.data(), x.size() * sizeof(float)) == 0);
+        };
+        auto sameCorners = [](const std::vector<ObjCorner>& x, const std::vector<ObjCorner>& y) {
+            return x.size() == y.size() && (x.empty() || std::memcmp(x.data(), y.data(), x.size() * sizeof(ObjCorner)) == 0);
+        };
+        return sameFloats(a.positions, b.positions) && sameFloats(a.texcoords, b.texcoords) && sameFloats(a.normals, b.normals)
+            && sameCorners(a.corners, b.corners) && a.materialIds == b.materialIds
+            && a.materialNames == b.materialNames && a.textureFiles == b.textureFiles;
+    };
+
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int maxThreads = std::max(hardwareThreads, 8u);
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+        start = std::chrono::steady_clock::now();
+        ObjData parsed;
+        bool ok = ParseObjParallel(path, "objs/", static_cast<int>(threads), parsed);
+        double ms = MillisecondsSince(start);
+        if (!ok) {
+            std::cout << "  parallel:    unsupported input, falls back to tinyobj\n";
+            return;
+        }
+        std::cout << "  parallel x" << threads << ": " << ms << " ms, " << megabytes / (ms / 1000.0) << " MB/s, "
+            << tinyobjMs / ms << "x tinyobj, output " << (same(reference, parsed) ? "identical" : "DIFFERS") << "\n";
+    }
+    std::cout << "  (" << hardwareThreads << " hardware threads)\n";
+}
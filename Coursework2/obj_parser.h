@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// one triangle corner, zero-based indices into ObjData's attribute arrays, -1 when absent
+struct ObjCorner {
+    int vertex;
+    int texcoord;
+    int normal;
+};
+
+// triangulated OBJ contents in file order, as LoadMeshByMaterial consumes them
+struct ObjData {
+    std::vector<float> positions;       // xyz
+    std::vector<float> texcoords;       // uv
+    std::vector<float> normals;         // xyz
+    std::vector<ObjCorner> corners;     // three per triangle
+    std::vector<int> materialIds;       // one per triangle, -1 for no material
+    std::vector<std::string> materialNames;
+    std::vector<std::string> textureFiles;
+};
+
+// single-threaded reference parse through tinyobj
+bool ParseObjTinyobj(const std::string& path, const std::string& mtlSearchPath, ObjData& out);
+
+// Maps the file, splits it at line boundaries and parses the chunks on worker threads,
+// then stitches them together with prefix sums. threadCount 0 uses every hardware thread.
+// Produces the same ObjData as ParseObjTinyobj; returns false for input it does not
+// handle (polygons over 4 corners, bad indices, mtllib after usemtl) so callers can fall back.
+bool ParseObjParallel(const std::string& path, const std::string& mtlSearchPath, int threadCount, ObjData& out);
+
+// --bench-obj: tinyobj vs. parallel throughput per thread count, plus an output comparison
+void RunObjParseBenchmark(const std::string& path);
@@ -1,5 +1,8 @@
 #include "player.h"
 #include "terrain.h"
+#include "mesh_simplifier.h"
+#include "gl_state.h"
+#include <algorithm>
 
 void Player::init(const glm::vec3& startPosition) {
 	position = startPosition;
@@ -12,56 +15,113 @@ void Player::SetTargetPosition(const glm::vec3& newTarget) {
     targetPosition = newTarget;
 }
 void Player::LoadModel(const std::string& path) {
-    vertices = LoadMyObjWithNormals(path);
+    mesh.Load(path);
+}
+
+void Player::SetupOpenGL() {
+    const auto& segments = mesh.GetSegments();
+
+    GLuint vertexTotal = 0;
+    size_t levels = 0;
+    for (const auto& seg : segments) {
+        vertexTotal += seg.vertexCount;
+        levels = std::max(levels, seg.lods.size());
+    }
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
+    glGenBuffers(1, &EBO);
+    BindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0); 
+    glBufferData(GL_ARRAY_BUFFER, vertexTotal * 8 * sizeof(float), nullptr, GL_STATIC_DRAW);
+
+    glm::vec3 minP(1e9f), maxP(-1e9f);
+    GLuint baseVertex = 0;
+    for (const auto& seg : segments) {
+        glBufferSubData(GL_ARRAY_BUFFER, baseVertex * 8 * sizeof(float), seg.vertexCount * 8 * sizeof(float), seg.vertices);
+        for (unsigned int v = 0; v < seg.vertexCount; v++) {
+            glm::vec3 p(seg.vertices[v * 8], seg.vertices[v * 8 + 1], seg.vertices[v * 8 + 2]);
+            minP = glm::min(minP, p);
+            maxP = glm::max(maxP, p);
+        }
+        baseVertex += seg.vertexCount;
+    }
+
+    // the player draws every material segment in one go, so each level of detail is one
+    // rebased range; a segment with fewer levels repeats its coarsest
+    std::vector<GLuint> indices;
+    indexType = vertexTotal <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    lods.clear();
+    for (size_t level = 0; level < levels; level++) {
+        MeshLod range;
+        range.firstIndex = static_cast<unsigned int>(indices.size());
+        baseVertex = 0;
+        for (const auto& seg : segments) {
+            const MeshLod& lod = seg.lods[std::min(level, seg.lods.size() - 1)];
+            for (unsigned int i = 0; i < lod.indexCount; i++)
+                indices.push_back(seg.Index(lod.firstIndex + i) + baseVertex);
+            range.error = std::max(range.error, lod.error);
+            baseVertex += seg.vertexCount;
+        }
+        range.indexCount = static_cast<unsigned int>(indices.size()) - range.firstIndex;
+        lods.push_back(range);
+    }
+    indexCount = lods.empty() ? 0 : static_cast<GLsizei>(lods[0].indexCount);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    if (indexType == GL_UNSIGNED_SHORT) {
+        std::vector<GLushort> narrow(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, narrow.size() * sizeof(GLushort), narrow.data(), GL_STATIC_DRAW);
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    }
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float))); 
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
     glEnableVertexAttribArray(1);
+    BindVertexArray(0);
 
+    boundsCenter = (minP + maxP) * 0.5f;
+    boundsRadius = glm::length(maxP - minP) * 0.5f;
+    mesh.Release();
 }
-void Player::RenderShadow(GLuint shader, const glm::mat4& lightSpaceMatrix) {
-    glUseProgram(shader);
 
-    glm::mat4 model = GetModelMatrix();
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
-
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 6);
+void Player::RegisterShadowCaster(ShadowPass& shadowPass) {
+    shadowMesh = shadowPass.AddIndexedMesh(VBO, EBO, 8 * sizeof(float), 0, indexCount, 0, indexType);
 }
 
-void Player::Render(GLuint shader, const glm::mat4& projection, const glm::mat4& view,
-    const glm::vec3& lightDir, const glm::vec3& lightColor,
-    const glm::vec3& viewPos, const glm::mat4& lightSpaceMatrix,
-    GLuint shadowMap, float sunElevation) {
-    glUseProgram(shader);
-
+void Player::SubmitShadowCaster(ShadowPass& shadowPass) const {
+    if (shadowMesh < 0)
+        return;
     glm::mat4 model = GetModelMatrix();
-    glm::mat4 mvp = projection * view * model;
-
-    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "MVP"), 1, GL_FALSE, glm::value_ptr(mvp));
-    glUniformMatrix4fv(glGetUniformLocation(shader, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
-
-    glUniform3fv(glGetUniformLocation(shader, "lightDir"), 1, glm::value_ptr(lightDir));
-    glUniform3fv(glGetUniformLocation(shader, "lightColor"), 1, glm::value_ptr(lightColor));
-    glUniform3fv(glGetUniformLocation(shader, "viewPos"), 1, glm::value_ptr(viewPos));
-
-    glUniform1f(glGetUniformLocation(shader, "sunElevation"), sunElevation);
+    glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+    float scale = glm::length(glm::vec3(model[0]));
+    if (shadowPass.IsVisible(center, boundsRadius * scale))
+        shadowPass.AddInstance(shadowMesh, model);
+}
 
+void Player::Submit(RenderQueue& queue, const ShaderProgram& shader, float lodPixelScale) const {
+    if (VAO == 0)
+        return;
 
-    glActiveTexture(GL_TEXTURE0 + 1);
-    glBindTexture(GL_TEXTURE_2D, shadowMap);
-    glUniform1i(glGetUniformLocation(shader, "shadowMap"), 1);
+    glm::mat4 model = GetModelMatrix();
 
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 6);
+    // shadows keep the full mesh; the visible one drops detail that would be under a pixel
+    float scale = glm::length(glm::vec3(model[0]));
+    glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+    float distance = queue.GetViewDistance(center) - boundsRadius * scale;
+    const MeshLod& lod = lods[SelectLod(lods, scale, distance, lodPixelScale)];
+
+    DrawPacket packet;
+    packet.program = &shader;
+    packet.vertexArray = VAO;
+    packet.model = queue.AddModel(model);
+    packet.kind = DrawKind::Elements;
+    packet.first = static_cast<GLint>(lod.firstIndex);
+    packet.count = static_cast<GLsizei>(lod.indexCount);
+    packet.indexType = indexType;
+    queue.Add(RenderPass::Opaque, packet, distance);
 }
 
 void Player::Update(float deltaTime, Terrain& terrain) {
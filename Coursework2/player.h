@@ -10,20 +10,24 @@
 #include <string>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "render_queue.h"
+#include "shadow_pass.h"
+#include "mesh_cache.h"
 
 class Player {
 public:
 	void init(const glm::vec3& startPosition);
+    // LoadModel only touches the CPU side and can run on a loader thread, SetupOpenGL uploads it
     void LoadModel(const std::string& path);
-    void Render(GLuint shader, const glm::mat4& projection, const glm::mat4& view,
-        const glm::vec3& lightDir, const glm::vec3& lightColor,
-        const glm::vec3& viewPos, const glm::mat4& lightSpaceMatrix,
-        GLuint shadowMap, float sunElevation);
+    void SetupOpenGL();
+    // camera and sun come from the FrameData block; the queue's view position picks the level of detail
+    void Submit(RenderQueue& queue, const ShaderProgram& shader, float lodPixelScale) const;
     void SetTargetPosition(const glm::vec3& newTarget);
     void Update(float deltaTime, Terrain &terrain);
     glm::mat4 GetModelMatrix() const;
     glm::vec3 GetPosition() const;
-    void RenderShadow(GLuint shader, const glm::mat4& lightSpaceMatrix);
+    void RegisterShadowCaster(ShadowPass& shadowPass);
+    void SubmitShadowCaster(ShadowPass& shadowPass) const;
 
 private:
     glm::vec3 position;
@@ -32,7 +36,14 @@ private:
     float targetAngle;
     float interpSpeed = 50.0f;
 
-    GLuint VAO = 0, VBO = 0;
-    std::vector<float> vertices;
+    MeshCache mesh;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLsizei indexCount = 0;             // full detail, also what the shadow pass draws
+    GLenum indexType = GL_UNSIGNED_INT;
+    std::vector<MeshLod> lods;          // one range of the index buffer per level
+
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    int shadowMesh = -1;
 };
 
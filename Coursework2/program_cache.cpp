@@ -0,0 +1,112 @@
+#include "program_cache.h"
+#include "gl_caps.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const char CACHE_DIRECTORY[] = "shadercache";
+const char BINARY_MAGIC[4] = { 'P', 'B', 'I', 'N' };
+const uint32_t BINARY_VERSION = 1;
+
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t binaryFormat;      // what glGetProgramBinary reported, handed back to glProgramBinary
+    uint32_t binarySize;
+    uint64_t key;
+};
+
+// the file name only tells tuples apart; whether the contents are current is the key's job
+std::string GetBinaryPath(const std::string& name) {
+    uint64_t nameHash = HashBytes(reinterpret_cast<const unsigned char*>(name.data()), name.size());
+    std::ostringstream path;
+    path << CACHE_DIRECTORY << "/" << std::hex << std::setw(16) << std::setfill('0') << nameHash << ".bin";
+    return path.str();
+}
+
+}
+
+uint64_t GetDriverHash() {
+    std::string driver;
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        driver += value ? value : "";
+        driver += '\n';
+    }
+    return HashBytes(reinterpret_cast<const unsigned char*>(driver.data()), driver.size());
+}
+
+GLuint LoadProgramBinary(const std::string& name, uint64_t key) {
+    if (!GetGLCaps().programBinary)
+        return 0;
+
+    MappedFile file;
+    BinaryHeader header;
+    if (!file.Open(GetBinaryPath(name)) || file.GetSize() < sizeof(header))
+        return 0;
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    if (std::memcmp(header.magic, BINARY_MAGIC, 4) != 0 || header.version != BINARY_VERSION
+        || header.key != key || sizeof(header) + header.binarySize > file.GetSize())
+        return 0;
+
+    // the driver may still refuse a binary from the same strings, e.g. after an update
+    // that kept its version string
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, file.GetData() + sizeof(header), static_cast<GLsizei>(header.binarySize));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool SaveProgramBinary(const std::string& name, uint64_t key, GLuint program) {
+    if (!GetGLCaps().programBinary)
+        return false;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    BinaryHeader header = {};
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return false;
+    std::memcpy(header.magic, BINARY_MAGIC, 4);
+    header.version = BINARY_VERSION;
+    header.binaryFormat = format;
+    header.binarySize = static_cast<uint32_t>(written);
+    header.key = key;
+
+    // write to a temporary name first so a half-written binary is never mapped
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIRECTORY, ec);
+    std::string binaryPath = GetBinaryPath(name);
+    std::string tempPath = binaryPath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), written);
+        if (!out)
+            return false;
+    }
+
+    std::filesystem::rename(tempPath, binaryPath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <GL/gl3w.h>
+
+// Linked program binaries kept in shadercache/, one file per (vs, fs, defines) tuple.
+// A file is only used when its key matches, a hash of both stages' final source and the
+// driver's vendor/renderer/version strings, and when the driver accepts the binary;
+// anything else means compiling from source and overwriting the file.
+
+// hash of the GL driver strings to mix into every key; GL thread, after context creation
+uint64_t GetDriverHash();
+
+// 0 when there is no usable binary for the key
+GLuint LoadProgramBinary(const std::string& name, uint64_t key);
+// the program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+bool SaveProgramBinary(const std::string& name, uint64_t key, GLuint program);
@@ -0,0 +1,430 @@
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "prop.h"
+#include "terrain.h"
+#include "mesh_cache.h"
+#include "texture.h"
+#include "gl_caps.h"
+#include "gl_state.h"
+#include "mesh_simplifier.h"
+#include <gl3w.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <iostream>
+#include <cmath>
+
+int PropRegistry::Register(const PropType& type) {
+    types.push_back(type);
+    instances.emplace_back();
+    return static_cast<int>(types.size()) - 1;
+}
+
+int PropRegistry::FindOrAddMaterial(const PropPart& part) {
+    for (size_t i = 0; i < materials.size(); i++) {
+        if (materials[i] == part.texturePath)
+            return static_cast<int>(i);
+    }
+
+    materials.push_back(part.texturePath);
+    materialPlaceholders.push_back(part.placeholderColor);
+    return static_cast<int>(materials.size()) - 1;
+}
+
+void PropRegistry::Scatter(float worldSize, Terrain& terrain) {
+    for (size_t t = 0; t < types.size(); t++) {
+        const PropDensity& rules = types[t].density;
+        std::vector<PropInstance>& placed = instances[t];
+        placed.clear();
+
+        size_t attempts = 0;
+        size_t maxAttempts = rules.count * 10;
+
+        while (placed.size() < rules.count && attempts < maxAttempts) {
+            attempts++;
+
+            float x = static_cast<float>(rand()) / RAND_MAX * worldSize;
+            float z = static_cast<float>(rand()) / RAND_MAX * worldSize;
+            float y = terrain.GetTileHeight(x, z);
+
+            // skip anything outside the height band (e.g. under the water plane)
+            if (y < rules.minHeight || y > rules.maxHeight)
+                continue;
+
+            // slope from the terrain normal, 0 when flat
+            float dx = terrain.GetTileHeight(x + 1.0f, z) - terrain.GetTileHeight(x - 1.0f, z);
+            float dz = terrain.GetTileHeight(x, z + 1.0f) - terrain.GetTileHeight(x, z - 1.0f);
+            glm::vec3 normal = glm::normalize(glm::vec3(-dx, 2.0f, -dz));
+            if (1.0f - normal.y > rules.maxSlope)
+                continue;
+
+            PropInstance instance;
+            instance.position = glm::vec3(x, y - rules.sink, z);
+            instance.scale = rules.minScale + static_cast<float>(rand()) / RAND_MAX * (rules.maxScale - rules.minScale);
+            instance.rotationY = static_cast<float>(rand()) / RAND_MAX * glm::two_pi<float>();
+            placed.push_back(instance);
+        }
+
+        if (placed.size() < rules.count) {
+            std::cout << "Only placed " << placed.size() << " " << types[t].name << " props out of "
+                << rules.count << " after " << attempts << " attempts.\n";
+        }
+    }
+}
+
+void PropRegistry::LoadMeshes() {
+    meshes = std::vector<MeshCache>(types.size());
+    for (size_t t = 0; t < types.size(); t++)
+        meshes[t].Load(types[t].meshPath);
+}
+
+void PropRegistry::SetupOpenGL(AssetLoader& assets) {
+    // every instance of every type goes into one buffer; UpdateDraws culls and orders it each frame
+    instanceTotal = 0;
+    models.assign(instances.size(), std::vector<glm::mat4>());
+    for (size_t t = 0; t < instances.size(); t++) {
+        for (const auto& instance : instances[t]) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), instance.position);
+            model = glm::rotate(model, instance.rotationY, glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(instance.scale));
+            models[t].push_back(model);
+        }
+        instanceTotal += instances[t].size();
+    }
+
+    // every part of every type shares one vertex/index buffer pair. Cached segments are
+    // uploaded untouched, the texture layer is a separate per-vertex stream.
+    std::vector<const MeshSegmentView*> sources;
+    GLuint vertexTotal = 0, indexTotal = 0;
+
+    typeLods.assign(types.size(), std::vector<MeshLod>());
+    for (size_t t = 0; t < types.size(); t++) {
+        const auto& segments = meshes[t].GetSegments();
+
+        glm::vec3 minP(1e9f), maxP(-1e9f);
+        for (const auto& seg : segments) {
+            for (unsigned int v = 0; v < seg.vertexCount; v++) {
+                glm::vec3 p(seg.vertices[v * 8], seg.vertices[v * 8 + 1], seg.vertices[v * 8 + 2]);
+                minP = glm::min(minP, p);
+                maxP = glm::max(maxP, p);
+            }
+        }
+        // a little slack for the vertex shader sway
+        types[t].boundsCenter = (minP + maxP) * 0.5f;
+        types[t].boundsRadius = glm::length(maxP - minP) * 0.5f + 0.2f;
+
+        for (const auto& seg : segments) {
+            auto part = std::find_if(types[t].parts.begin(), types[t].parts.end(),
+                [&](const PropPart& p) { return p.materialName == seg.materialName; });
+            if (part == types[t].parts.end()) {
+                std::cerr << "Unknown material: " << seg.materialName << " in " << types[t].meshPath << "\n";
+                continue;
+            }
+
+            Batch batch;
+            batch.type = static_cast<int>(t);
+            batch.material = FindOrAddMaterial(*part);
+            batch.alphaTested = part->alphaTested;
+            batch.baseVertex = static_cast<GLint>(vertexTotal);
+            batch.lods = seg.lods;
+            for (auto& lod : batch.lods)
+                lod.firstIndex += indexTotal;
+            vertexTotal += seg.vertexCount;
+            indexTotal += seg.indexCount;
+
+            // an instance picks one level for all its parts, so judge it by the worst part
+            std::vector<MeshLod>& levels = typeLods[t];
+            if (levels.size() < seg.lods.size())
+                levels.resize(seg.lods.size());
+            for (size_t l = 0; l < levels.size(); l++)
+                levels[l].error = std::max(levels[l].error, seg.lods[std::min(l, seg.lods.size() - 1)].error);
+
+            batches.push_back(batch);
+            sources.push_back(&seg);
+        }
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &layerVBO);
+    glGenBuffers(1, &EBO);
+
+    BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexTotal * 8 * sizeof(float), nullptr, GL_STATIC_DRAW);
+    // indices are relative to each range's base vertex, so 16 bits do as long as every segment fits
+    bool shortIndices = std::all_of(sources.begin(), sources.end(),
+        [](const MeshSegmentView* seg) { return seg->indexSize == 2; });
+    indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    indexSize = shortIndices ? sizeof(GLushort) : sizeof(GLuint);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexTotal * indexSize, nullptr, GL_STATIC_DRAW);
+
+    std::vector<float> layers(vertexTotal);
+    for (size_t b = 0; b < batches.size(); b++) {
+        const MeshSegmentView& seg = *sources[b];
+        glBufferSubData(GL_ARRAY_BUFFER, batches[b].baseVertex * 8 * sizeof(float), seg.vertexCount * 8 * sizeof(float), seg.vertices);
+        if (seg.indexSize == indexSize) {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, batches[b].lods[0].firstIndex * indexSize, seg.indexCount * indexSize, seg.indices);
+        }
+        else {
+            std::vector<GLuint> wide(seg.indexCount);
+            for (unsigned int i = 0; i < seg.indexCount; i++)
+                wide[i] = seg.Index(i);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, batches[b].lods[0].firstIndex * indexSize, wide.size() * indexSize, wide.data());
+        }
+        std::fill(layers.begin() + batches[b].baseVertex, layers.begin() + batches[b].baseVertex + seg.vertexCount,
+            static_cast<float>(batches[b].material));
+    }
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);                   // Position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float))); // TexCoord
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float))); // Normal
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ARRAY_BUFFER, layerVBO);
+    glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(float), layers.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);                       // Texture layer
+    glEnableVertexAttribArray(7);
+
+    // keep each type's parts together so the fallback path rebinds instance data once per type
+    std::stable_sort(batches.begin(), batches.end(),
+        [](const Batch& a, const Batch& b) { return a.type < b.type; });
+
+    // per-instance model matrix, one column per attribute slot; filled by UpdateDraws
+    instanceBuffer.Init(GL_ARRAY_BUFFER, instanceTotal * sizeof(glm::mat4));
+    for (int c = 0; c < 4; c++) {
+        glEnableVertexAttribArray(3 + c);
+        glVertexAttribDivisor(3 + c, 1);
+    }
+    BindInstanceRange(0);
+    BindVertexArray(0);
+
+    // with base instance support the whole forest is one indirect draw
+    useIndirect = GetGLCaps().multiDrawIndirect;
+    if (useIndirect) {
+        // at most every part at every level
+        size_t maxDraws = 0;
+        for (const Batch& batch : batches)
+            maxDraws += batch.lods.size();
+        indirectBuffer.Init(GL_DRAW_INDIRECT_BUFFER, maxDraws * sizeof(DrawElementsIndirectCommand));
+    }
+
+    instanceLods.clear();
+    instanceDistances.clear();
+    for (size_t t = 0; t < instances.size(); t++) {
+        instanceLods.emplace_back(instances[t].size(), 0xff);
+        instanceDistances.emplace_back(instances[t].size(), 0.0f);
+    }
+
+    // the mapped meshes are no longer needed once uploaded
+    std::vector<MeshCache>().swap(meshes);
+
+    textureArray = assets.LoadTextureArray(materials, materialPlaceholders);
+
+    std::cout << "Props: " << batches.size() << " draw ranges, " << vertexTotal << " vertices, "
+        << instanceTotal << " instances, " << materials.size() << " texture layers"
+        << (useIndirect ? ", multi-draw indirect" : "") << "\n";
+}
+
+void PropRegistry::UpdateDraws(const glm::vec3& cameraPos, const Frustum& frustum, float pixelScale) {
+    if (batches.empty())
+        return;
+
+    // pick a level per visible instance and only touch the buffers when some instance
+    // changed level or came into or out of view
+    bool changed = draws.empty();
+    visibleInstances = 0;
+    for (size_t t = 0; t < types.size(); t++) {
+        for (size_t i = 0; i < instances[t].size(); i++) {
+            const PropInstance& instance = instances[t][i];
+            glm::vec3 center = glm::vec3(models[t][i] * glm::vec4(types[t].boundsCenter, 1.0f));
+            float radius = types[t].boundsRadius * instance.scale;
+            float distance = glm::length(center - cameraPos) - radius;
+            instanceDistances[t][i] = distance;
+            unsigned char level = CULLED;
+            if (frustum.IsVisible(center, radius)) {
+                level = static_cast<unsigned char>(SelectLod(typeLods[t], instance.scale, distance, pixelScale));
+                visibleInstances++;
+            }
+            if (instanceLods[t][i] != level) {
+                instanceLods[t][i] = level;
+                changed = true;
+            }
+        }
+    }
+    if (!changed)
+        return;
+
+    // visible instances grouped by type, then level, so every (part, level) pair is one
+    // instance run; culled ones match no level
+    glm::mat4* sortedModels = static_cast<glm::mat4*>(instanceBuffer.Map(instanceTotal * sizeof(glm::mat4)));
+    GLuint sortedCount = 0;
+    draws.clear();
+    size_t firstBatch = 0;
+    for (size_t t = 0; t < types.size(); t++) {
+        size_t lastBatch = firstBatch;
+        while (lastBatch < batches.size() && batches[lastBatch].type == static_cast<int>(t))
+            lastBatch++;
+
+        for (size_t l = 0; l < typeLods[t].size(); l++) {
+            GLuint first = sortedCount;
+            float nearest = std::numeric_limits<float>::max();
+            for (size_t i = 0; i < instances[t].size(); i++) {
+                if (instanceLods[t][i] == l) {
+                    sortedModels[sortedCount++] = models[t][i];
+                    nearest = std::min(nearest, instanceDistances[t][i]);
+                }
+            }
+            GLsizei count = static_cast<GLsizei>(sortedCount - first);
+            if (count == 0)
+                continue;
+
+            for (size_t b = firstBatch; b < lastBatch; b++) {
+                Draw draw;
+                draw.batch = static_cast<int>(b);
+                draw.lod = static_cast<int>(std::min(l, batches[b].lods.size() - 1));
+                draw.firstInstance = first;
+                draw.instanceCount = count;
+                draw.nearest = nearest;
+                draws.push_back(draw);
+            }
+        }
+        firstBatch = lastBatch;
+    }
+    instanceBuffer.Unmap();
+
+    // the new region is elsewhere in the ring; earlier frames keep reading the old one
+    BindVertexArray(VAO);
+    BindInstanceRange(0);
+    BindVertexArray(0);
+
+    // each half is drawn with its own program; the indirect path submits each as one range
+    auto alphaTested = std::stable_partition(draws.begin(), draws.end(),
+        [this](const Draw& draw) { return !batches[draw.batch].alphaTested; });
+    firstAlphaTestedDraw = static_cast<size_t>(alphaTested - draws.begin());
+
+    if (useIndirect && !draws.empty()) {
+        DrawElementsIndirectCommand* commands = static_cast<DrawElementsIndirectCommand*>(
+            indirectBuffer.Map(draws.size() * sizeof(DrawElementsIndirectCommand)));
+        for (size_t d = 0; d < draws.size(); d++) {
+            const Batch& batch = batches[draws[d].batch];
+            DrawElementsIndirectCommand& cmd = commands[d];
+            cmd.count = batch.lods[draws[d].lod].indexCount;
+            cmd.instanceCount = static_cast<GLuint>(draws[d].instanceCount);
+            cmd.firstIndex = batch.lods[draws[d].lod].firstIndex;
+            cmd.baseVertex = batch.baseVertex;
+            cmd.baseInstance = draws[d].firstInstance;
+        }
+        indirectBuffer.Unmap();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
+
+void PropRegistry::BindInstanceRange(GLuint first) const {
+    // only used without base instance support: slide the instance attributes to this run
+    boundInstance = first;
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.GetBuffer());
+    size_t base = instanceBuffer.GetOffset() + first * sizeof(glm::mat4);
+    for (int c = 0; c < 4; c++) {
+        glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(base + c * sizeof(glm::vec4)));
+    }
+}
+
+void PropRegistry::RegisterShadowCasters(ShadowPass& shadowPass) {
+    for (auto& batch : batches) {
+        batch.shadowMesh = shadowPass.AddIndexedMesh(VBO, EBO, 8 * sizeof(float), batch.lods[0].firstIndex,
+            static_cast<GLsizei>(batch.lods[0].indexCount), batch.baseVertex, indexType);
+    }
+}
+
+void PropRegistry::SubmitShadowCasters(ShadowPass& shadowPass) const {
+    if (batches.empty())
+        return;
+
+    for (size_t t = 0; t < types.size(); t++) {
+        for (size_t i = 0; i < instances[t].size(); i++) {
+            const glm::mat4& model = models[t][i];
+            glm::vec3 center = glm::vec3(model * glm::vec4(types[t].boundsCenter, 1.0f));
+            if (!shadowPass.IsVisible(center, types[t].boundsRadius * instances[t][i].scale))
+                continue;
+
+            for (const auto& batch : batches) {
+                if (batch.type == static_cast<int>(t))
+                    shadowPass.AddInstance(batch.shadowMesh, model);
+            }
+        }
+    }
+}
+
+void PropRegistry::Submit(RenderQueue& queue, RenderPass pass, const ShaderProgram& opaqueShader,
+    const ShaderProgram& alphaTestShader) const {
+    if (batches.empty())
+        return;
+
+    // samplers: treeTextures on unit 0, shadowMap on SHADOW_MAP_UNIT, set when the programs are loaded
+    DrawPacket packet;
+    packet.vertexArray = VAO;
+    packet.AddTexture(0, GL_TEXTURE_2D_ARRAY, textureArray);
+    packet.indexType = indexType;
+
+    if (useIndirect) {
+        // both ranges span the whole forest, so there is no distance to sort them by
+        packet.kind = DrawKind::MultiElementsIndirect;
+        packet.indirectBuffer = indirectBuffer.GetBuffer();
+        packet.indirectOffset = indirectBuffer.GetOffset();
+        if (firstAlphaTestedDraw > 0) {
+            packet.program = &opaqueShader;
+            packet.first = 0;
+            packet.count = static_cast<GLsizei>(firstAlphaTestedDraw);
+            queue.Add(pass, packet);
+        }
+        if (firstAlphaTestedDraw < draws.size()) {
+            packet.program = &alphaTestShader;
+            packet.first = static_cast<GLint>(firstAlphaTestedDraw);
+            packet.count = static_cast<GLsizei>(draws.size() - firstAlphaTestedDraw);
+            queue.Add(pass, packet);
+        }
+        return;
+    }
+
+    packet.kind = DrawKind::Elements;
+    packet.owner = this;
+    packet.beforeDraw = [](const void* owner, const DrawPacket& draw) {
+        const PropRegistry* props = static_cast<const PropRegistry*>(owner);
+        if (props->boundInstance != draw.firstInstance)
+            props->BindInstanceRange(draw.firstInstance);
+    };
+    for (size_t d = 0; d < draws.size(); d++) {
+        const Draw& draw = draws[d];
+        const Batch& batch = batches[draw.batch];
+        const MeshLod& lod = batch.lods[draw.lod];
+        packet.program = d < firstAlphaTestedDraw ? &opaqueShader : &alphaTestShader;
+        packet.first = static_cast<GLint>(lod.firstIndex);
+        packet.count = static_cast<GLsizei>(lod.indexCount);
+        packet.instanceCount = draw.instanceCount;
+        packet.baseVertex = batch.baseVertex;
+        packet.firstInstance = draw.firstInstance;
+        queue.Add(pass, packet, draw.nearest);
+    }
+}
+
+void PropRegistry::Cleanup() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &layerVBO);
+    glDeleteBuffers(1, &EBO);
+    instanceBuffer.Cleanup();
+    indirectBuffer.Cleanup();
+    batches.clear();
+    draws.clear();
+    materials.clear();
+    materialPlaceholders.clear();
+}
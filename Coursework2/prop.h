@@ -0,0 +1,133 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/gl3w.h>
+#include "terrain.h"
+#include "shadow_pass.h"
+#include "mesh_cache.h"
+#include "asset_loader.h"
+#include "shader.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+#include "frustum.h"
+
+// one material segment of a prop mesh and the texture it is drawn with
+struct PropPart {
+    std::string materialName;
+    std::string texturePath;
+    glm::vec4 placeholderColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);    // shown until the texture loads
+    bool alphaTested = false;   // cutout texture such as leaves, drawn with the ALPHA_TEST program
+};
+
+// placement rules used when scattering a prop type over the terrain
+struct PropDensity {
+    size_t count = 0;
+    float minHeight = -1.5f;
+    float maxHeight = 1000.0f;
+    float maxSlope = 1.0f;      // 0 = flat ground only, 1 = any slope
+    float minScale = 1.0f;
+    float maxScale = 1.0f;
+    float sink = 0.0f;          // sink into ground to hide the base
+};
+
+struct PropType {
+    std::string name;
+    std::string meshPath;
+    std::vector<PropPart> parts;
+    PropDensity density;
+
+    // model-space bounding sphere, filled in when the mesh is loaded
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+};
+
+struct PropInstance {
+    glm::vec3 position;
+    float scale;
+    float rotationY;
+};
+
+class PropRegistry {
+public:
+    int Register(const PropType& type);
+    void Scatter(float worldSize, Terrain& terrain);
+    // CPU side only, safe on a loader thread; SetupOpenGL then uploads and releases the meshes
+    void LoadMeshes();
+    void SetupOpenGL(AssetLoader& assets);
+    // culls instances against frustum, picks a level of detail for the rest and regroups the
+    // instance buffer and indirect commands to match; call once per frame before Submit.
+    // pixelScale as for SelectLod
+    void UpdateDraws(const glm::vec3& cameraPos, const Frustum& frustum, float pixelScale);
+    int GetInstanceCount() const { return static_cast<int>(instanceTotal); }
+    // inside the frustum at the last UpdateDraws
+    int GetVisibleInstanceCount() const { return visibleInstances; }
+    // camera, sun and sway time come from the FrameData block, the shadow map from SHADOW_MAP_UNIT.
+    // Opaque parts are drawn with the first program, alpha-tested ones with the second. For
+    // the depth prepass pass the depth-only programs, so the color pass can run with GL_EQUAL
+    // and no discard
+    void Submit(RenderQueue& queue, RenderPass pass, const ShaderProgram& opaqueShader,
+        const ShaderProgram& alphaTestShader) const;
+    void RegisterShadowCasters(ShadowPass& shadowPass);
+    void SubmitShadowCasters(ShadowPass& shadowPass) const;
+    void Cleanup();
+
+private:
+    // one instanced draw range in the shared buffers: a single part of a single prop type
+    struct Batch {
+        int type = 0;
+        int material = 0;           // texture array layer
+        bool alphaTested = false;
+        GLint baseVertex = 0;
+        std::vector<MeshLod> lods;  // index ranges, absolute in the shared EBO; shadows use lods[0]
+        int shadowMesh = -1;
+    };
+
+    // one instanced draw of this frame: a batch at one level for a run of instances
+    struct Draw {
+        int batch = 0;
+        int lod = 0;
+        GLuint firstInstance = 0;
+        GLsizei instanceCount = 0;
+        float nearest = 0.0f;       // closest instance when the runs were last regrouped, for sorting
+    };
+
+    // layout consumed by glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    int FindOrAddMaterial(const PropPart& part);
+    void BindInstanceRange(GLuint first) const;
+
+    std::vector<PropType> types;
+    std::vector<std::vector<PropInstance>> instances;
+    std::vector<std::vector<glm::mat4>> models;
+    std::vector<std::vector<MeshLod>> typeLods;         // per type, worst error over its parts
+    static const unsigned char CULLED = 0xfe;           // instanceLods entry outside the frustum
+    std::vector<std::vector<unsigned char>> instanceLods;
+    std::vector<std::vector<float>> instanceDistances;  // from the camera at the last UpdateDraws
+    std::vector<Draw> draws;                            // opaque parts first
+    size_t firstAlphaTestedDraw = 0;
+    std::vector<std::string> materials;
+    std::vector<glm::vec4> materialPlaceholders;
+    std::vector<MeshCache> meshes;
+    std::vector<Batch> batches;
+
+    // all prop geometry lives in one vertex/index buffer pair behind a single VAO
+    GLuint VAO = 0, VBO = 0, layerVBO = 0, EBO = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexSize = sizeof(GLuint);
+    StreamBuffer instanceBuffer;    // model matrices, type then level; rewritten when levels change
+    StreamBuffer indirectBuffer;
+    size_t instanceTotal = 0;
+    int visibleInstances = 0;
+    GLuint textureArray = 0;        // owned by the asset loader
+    bool useIndirect = false;
+    mutable GLuint boundInstance = 0;   // run the instance attributes point at without base instance
+};
@@ -0,0 +1,247 @@
+#include "render_graph.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+bool IsDepthFormat(GLenum internalFormat) {
+    return internalFormat == GL_DEPTH_COMPONENT || internalFormat == GL_DEPTH_COMPONENT16
+        || internalFormat == GL_DEPTH_COMPONENT24 || internalFormat == GL_DEPTH_COMPONENT32
+        || internalFormat == GL_DEPTH_COMPONENT32F;
+}
+
+// what the driver most likely stores per texel, for the pool report
+size_t GetBytesPerPixel(GLenum internalFormat) {
+    switch (internalFormat) {
+    case GL_RGBA16F: case GL_RGB16F: case GL_RG32F: return 8;
+    case GL_RGBA32F: case GL_RGB32F: return 16;
+    default: return 4;      // 8-bit RGB is padded to RGBA, depth is 24 or 32 bits
+    }
+}
+
+bool SameDesc(const RenderTargetDesc& a, const RenderTargetDesc& b) {
+    return a.width == b.width && a.height == b.height && a.internalFormat == b.internalFormat
+        && a.filter == b.filter && a.wrap == b.wrap;
+}
+
+}
+
+void RenderGraph::BeginFrame(GLsizei backbufferWidth, GLsizei backbufferHeight) {
+    this->backbufferWidth = backbufferWidth;
+    this->backbufferHeight = backbufferHeight;
+    passes.clear();
+    resources.clear();
+
+    Resource backbuffer;
+    backbuffer.name = "backbuffer";
+    backbuffer.desc.width = backbufferWidth;
+    backbuffer.desc.height = backbufferHeight;
+    resources.push_back(backbuffer);
+}
+
+RenderResource RenderGraph::CreateTarget(const std::string& name, const RenderTargetDesc& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    if (resource.desc.width == 0 || resource.desc.height == 0) {
+        resource.desc.width = backbufferWidth;
+        resource.desc.height = backbufferHeight;
+    }
+    resources.push_back(resource);
+    return static_cast<RenderResource>(resources.size()) - 1;
+}
+
+int RenderGraph::AddPass(const std::string& name, std::function<void()> execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes.push_back(std::move(pass));
+    return static_cast<int>(passes.size()) - 1;
+}
+
+void RenderGraph::Read(int pass, RenderResource resource) {
+    passes[pass].reads.push_back(resource);
+}
+
+void RenderGraph::Write(int pass, RenderResource resource) {
+    passes[pass].writes.push_back(resource);
+}
+
+GLuint RenderGraph::GetTexture(RenderResource resource) const {
+    int pooled = resources[resource].pooled;
+    return pooled >= 0 ? pool[pooled].texture : 0;
+}
+
+void RenderGraph::Cull() {
+    // walk back from the backbuffer: a pass is kept when a kept pass reads what it writes
+    std::vector<bool> neededResources(resources.size(), false);
+    neededResources[GetBackbuffer()] = true;
+    for (int p = static_cast<int>(passes.size()) - 1; p >= 0; p--) {
+        Pass& pass = passes[p];
+        pass.needed = std::any_of(pass.writes.begin(), pass.writes.end(),
+            [&](RenderResource resource) { return neededResources[resource]; });
+        if (pass.needed) {
+            for (RenderResource resource : pass.reads)
+                neededResources[resource] = true;
+        }
+    }
+
+    for (int p = 0; p < static_cast<int>(passes.size()); p++) {
+        if (!passes[p].needed)
+            continue;
+        for (const auto* list : { &passes[p].reads, &passes[p].writes }) {
+            for (RenderResource resource : *list) {
+                if (resources[resource].firstPass < 0)
+                    resources[resource].firstPass = p;
+                resources[resource].lastPass = p;
+            }
+        }
+    }
+}
+
+int RenderGraph::Acquire(const RenderTargetDesc& desc) {
+    for (size_t i = 0; i < pool.size(); i++) {
+        if (!pool[i].inUse && SameDesc(pool[i].desc, desc)) {
+            pool[i].inUse = true;
+            pool[i].usedThisFrame = true;
+            return static_cast<int>(i);
+        }
+    }
+
+    PooledTexture entry;
+    entry.desc = desc;
+    entry.inUse = true;
+    entry.usedThisFrame = true;
+    glGenTextures(1, &entry.texture);
+    BindTextureToEdit(GL_TEXTURE_2D, entry.texture);
+    bool depth = IsDepthFormat(desc.internalFormat);
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0,
+        depth ? GL_DEPTH_COMPONENT : GL_RGBA, depth ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, desc.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, desc.wrap);
+    if (desc.wrap == GL_CLAMP_TO_BORDER) {
+        float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+    }
+    pool.push_back(entry);
+    poolChanged = true;
+    return static_cast<int>(pool.size()) - 1;
+}
+
+GLuint RenderGraph::GetFramebuffer(const Pass& pass) {
+    Framebuffer wanted;
+    for (RenderResource resource : pass.writes) {
+        if (resource == GetBackbuffer())
+            return 0;
+        if (IsDepthFormat(resources[resource].desc.internalFormat))
+            wanted.depth = GetTexture(resource);
+        else
+            wanted.colors.push_back(GetTexture(resource));
+    }
+    for (const Framebuffer& framebuffer : framebuffers) {
+        if (framebuffer.depth == wanted.depth && framebuffer.colors == wanted.colors)
+            return framebuffer.fbo;
+    }
+
+    glGenFramebuffers(1, &wanted.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, wanted.fbo);
+    std::vector<GLenum> drawBuffers;
+    for (size_t c = 0; c < wanted.colors.size(); c++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(c), GL_TEXTURE_2D, wanted.colors[c], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(c));
+    }
+    if (wanted.depth != 0)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, wanted.depth, 0);
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    else {
+        glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Render graph: framebuffer for pass " << pass.name << " not complete!" << std::endl;
+
+    framebuffers.push_back(wanted);
+    return wanted.fbo;
+}
+
+void RenderGraph::Execute() {
+    Cull();
+
+    std::string schedule, culled;
+    for (const Pass& pass : passes) {
+        if (!pass.needed)
+            culled += " " + pass.name;
+        else
+            schedule += (schedule.empty() ? "" : " -> ") + pass.name;
+    }
+    if (!culled.empty())
+        schedule += ", culled:" + culled;
+
+    for (int p = 0; p < static_cast<int>(passes.size()); p++) {
+        const Pass& pass = passes[p];
+        if (!pass.needed)
+            continue;
+
+        for (size_t r = 1; r < resources.size(); r++) {
+            if (resources[r].firstPass == p)
+                resources[r].pooled = Acquire(resources[r].desc);
+        }
+
+        const RenderTargetDesc& target = resources[pass.writes.front()].desc;
+        glBindFramebuffer(GL_FRAMEBUFFER, GetFramebuffer(pass));
+        glViewport(0, 0, target.width, target.height);
+        pass.execute();
+
+        // from here on another target may take the texture over
+        for (size_t r = 1; r < resources.size(); r++) {
+            if (resources[r].lastPass == p)
+                pool[resources[r].pooled].inUse = false;
+        }
+    }
+    FreeUnused();
+
+    if (schedule != lastSchedule || poolChanged) {
+        size_t bytes = 0;
+        for (const PooledTexture& entry : pool)
+            bytes += static_cast<size_t>(entry.desc.width) * entry.desc.height * GetBytesPerPixel(entry.desc.internalFormat);
+        std::cout << "Render graph: " << schedule << "; " << pool.size() << " pooled targets, "
+            << bytes / (1024.0 * 1024.0) << " MB\n";
+        lastSchedule = schedule;
+        poolChanged = false;
+    }
+}
+
+void RenderGraph::FreeUnused() {
+    // left over from a resize or a pass that stopped running
+    for (size_t i = pool.size(); i-- > 0;) {
+        if (pool[i].usedThisFrame) {
+            pool[i].usedThisFrame = false;
+            continue;
+        }
+        GLuint texture = pool[i].texture;
+        for (size_t f = framebuffers.size(); f-- > 0;) {
+            const Framebuffer& framebuffer = framebuffers[f];
+            if (framebuffer.depth == texture || std::find(framebuffer.colors.begin(), framebuffer.colors.end(), texture) != framebuffer.colors.end()) {
+                glDeleteFramebuffers(1, &framebuffer.fbo);
+                framebuffers.erase(framebuffers.begin() + f);
+            }
+        }
+        DeleteTexture(texture);
+        pool.erase(pool.begin() + i);
+        poolChanged = true;
+    }
+}
+
+void RenderGraph::Cleanup() {
+    for (const Framebuffer& framebuffer : framebuffers)
+        glDeleteFramebuffers(1, &framebuffer.fbo);
+    for (const PooledTexture& entry : pool)
+        DeleteTexture(entry.texture);
+    framebuffers.clear();
+    pool.clear();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <GL/gl3w.h>
+
+// a render target as passes ask for it; sizes of 0 follow the backbuffer
+struct RenderTargetDesc {
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLenum internalFormat = GL_RGBA8;       // GL_DEPTH_COMPONENT* becomes a depth attachment
+    GLenum filter = GL_LINEAR;
+    GLenum wrap = GL_CLAMP_TO_EDGE;         // GL_CLAMP_TO_BORDER reads 1.0 outside, unshadowed for depth maps
+};
+
+// handle to a target of the frame being built
+typedef int RenderResource;
+
+// The frame as passes that declare which targets they read and write, rebuilt every
+// frame. Execute drops passes nothing on screen depends on, gives each target a texture
+// from a pool for the stretch of passes that use it, so targets whose uses do not
+// overlap share memory, binds a framebuffer for each pass's writes with a matching
+// viewport, and runs the passes in the order they were added. Targets that follow the
+// backbuffer are reallocated here when it resizes; pooled textures a frame did not use
+// are freed.
+class RenderGraph {
+public:
+    void BeginFrame(GLsizei backbufferWidth, GLsizei backbufferHeight);
+    RenderResource CreateTarget(const std::string& name, const RenderTargetDesc& desc);
+    // the window's default framebuffer; passes that write it are what the frame is for
+    RenderResource GetBackbuffer() const { return 0; }
+
+    int AddPass(const std::string& name, std::function<void()> execute);
+    void Read(int pass, RenderResource resource);
+    // a pass writes either the backbuffer or targets, up to one depth and any number of colors
+    void Write(int pass, RenderResource resource);
+
+    void Execute();
+    // only while a pass that uses the target runs
+    GLuint GetTexture(RenderResource resource) const;
+
+    void Cleanup();
+
+private:
+    struct Resource {
+        std::string name;
+        RenderTargetDesc desc;      // size resolved against the backbuffer
+        int pooled = -1;            // index into pool while in use
+        int firstPass = -1, lastPass = -1;
+    };
+
+    struct Pass {
+        std::string name;
+        std::function<void()> execute;
+        std::vector<RenderResource> reads;
+        std::vector<RenderResource> writes;
+        bool needed = false;
+    };
+
+    struct PooledTexture {
+        RenderTargetDesc desc;
+        GLuint texture = 0;
+        bool inUse = false;
+        bool usedThisFrame = false;
+    };
+
+    struct Framebuffer {
+        std::vector<GLuint> colors;
+        GLuint depth = 0;
+        GLuint fbo = 0;
+    };
+
+    void Cull();
+    int Acquire(const RenderTargetDesc& desc);
+    GLuint GetFramebuffer(const Pass& pass);
+    void FreeUnused();
+
+    GLsizei backbufferWidth = 0, backbufferHeight = 0;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<PooledTexture> pool;
+    std::vector<Framebuffer> framebuffers;
+    std::string lastSchedule;
+    bool poolChanged = false;       // reported with the schedule
+};
@@ -0,0 +1,144 @@
+#include "render_queue.h"
+#include "gl_state.h"
+#include <algorithm>
+
+namespace {
+
+const int PASS_SHIFT = 60;
+const int STATE_BITS = 12;          // per program, texture and vertex array; GL names are small
+const int DEPTH_BITS = 24;
+const uint64_t STATE_MASK = (1ull << STATE_BITS) - 1;
+const uint64_t DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+const size_t ELEMENTS_COMMAND_SIZE = 5 * sizeof(GLuint);
+const size_t ARRAYS_COMMAND_SIZE = 4 * sizeof(GLuint);
+
+}
+
+void DrawPacket::AddTexture(GLuint unit, GLenum target, GLuint texture) {
+    if (textureCount < MAX_TEXTURES)
+        textures[textureCount++] = { unit, target, texture };
+}
+
+void RenderQueue::Begin(const glm::vec3& viewPos, float farPlane) {
+    this->viewPos = viewPos;
+    this->farPlane = farPlane;
+    packets.clear();
+    models.clear();
+    items.clear();
+    drawCount = 0;
+}
+
+float RenderQueue::GetViewDistance(const glm::vec3& point) const {
+    return glm::length(point - viewPos);
+}
+
+int RenderQueue::AddModel(const glm::mat4& model) {
+    models.push_back(model);
+    return static_cast<int>(models.size()) - 1;
+}
+
+void RenderQueue::Add(RenderPass pass, const DrawPacket& packet, float viewDistance) {
+    if (!packet.program || !packet.program->IsReady())
+        return;
+    items.push_back({ MakeKey(pass, packet, viewDistance), static_cast<uint32_t>(packets.size()) });
+    packets.push_back(packet);
+}
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, const DrawPacket& packet, float viewDistance) const {
+    uint64_t program = packet.program->GetId() & STATE_MASK;
+    uint64_t texture = (packet.textureCount > 0 ? packet.textures[0].texture : 0) & STATE_MASK;
+    uint64_t vertexArray = packet.vertexArray & STATE_MASK;
+    float scaled = glm::clamp(viewDistance / farPlane, 0.0f, 1.0f);
+    uint64_t depth = static_cast<uint64_t>(scaled * DEPTH_MASK);
+
+    uint64_t key = static_cast<uint64_t>(pass) << PASS_SHIFT;
+    if (pass == RenderPass::Transparent) {
+        key |= (DEPTH_MASK - depth) << (3 * STATE_BITS);
+        key |= program << (2 * STATE_BITS) | texture << STATE_BITS | vertexArray;
+    }
+    else {
+        key |= program << (2 * STATE_BITS + DEPTH_BITS) | texture << (STATE_BITS + DEPTH_BITS) | vertexArray << DEPTH_BITS;
+        key |= depth;
+    }
+    return key;
+}
+
+void RenderQueue::Sort() {
+    // least significant byte first; a byte every key shares leaves the order as it is
+    scratch.resize(items.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (const SortItem& item : items)
+            offsets[(item.key >> shift) & 0xff]++;
+        if (std::find(std::begin(offsets), std::end(offsets), items.size()) != std::end(offsets))
+            continue;
+
+        size_t total = 0;
+        for (size_t& offset : offsets) {
+            size_t count = offset;
+            offset = total;
+            total += count;
+        }
+        for (const SortItem& item : items)
+            scratch[offsets[(item.key >> shift) & 0xff]++] = item;
+        items.swap(scratch);
+    }
+}
+
+void RenderQueue::SetPassState(RenderPass pass, const PassState& state) {
+    passStates[static_cast<int>(pass)] = state;
+}
+
+void RenderQueue::Submit(RenderPass pass) {
+    const PassState& state = passStates[static_cast<int>(pass)];
+    SetColorMask(state.colorWrite);
+    SetDepthMask(state.depthWrite);
+    SetDepthFunc(state.depthFunc);
+    SetBlendFunc(state.blendSource, state.blendDestination);
+
+    uint64_t passKey = static_cast<uint64_t>(pass) << PASS_SHIFT;
+    auto first = std::lower_bound(items.begin(), items.end(), passKey,
+        [](const SortItem& item, uint64_t key) { return item.key < key; });
+    for (auto it = first; it != items.end() && (it->key >> PASS_SHIFT) == static_cast<uint64_t>(pass); ++it)
+        Draw(packets[it->packet]);
+}
+
+void RenderQueue::Draw(const DrawPacket& packet) {
+    packet.program->Use();
+    BindVertexArray(packet.vertexArray);
+    for (int t = 0; t < packet.textureCount; t++)
+        BindTexture(packet.textures[t].unit, packet.textures[t].target, packet.textures[t].texture);
+    if (packet.model >= 0)
+        packet.program->SetMat4(UniformId("model"), models[packet.model]);
+    if (packet.beforeDraw)
+        packet.beforeDraw(packet.owner, packet);
+
+    drawCount++;
+    switch (packet.kind) {
+    case DrawKind::Arrays:
+        if (packet.instanceCount == 1)
+            glDrawArrays(packet.mode, packet.first, packet.count);
+        else
+            glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instanceCount);
+        break;
+    case DrawKind::Elements: {
+        size_t indexSize = packet.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        void* offset = (void*)(packet.first * indexSize);
+        if (packet.instanceCount == 1)
+            glDrawElementsBaseVertex(packet.mode, packet.count, packet.indexType, offset, packet.baseVertex);
+        else
+            glDrawElementsInstancedBaseVertex(packet.mode, packet.count, packet.indexType, offset, packet.instanceCount, packet.baseVertex);
+        break;
+    }
+    case DrawKind::MultiElementsIndirect:
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirectBuffer);
+        glMultiDrawElementsIndirect(packet.mode, packet.indexType, (void*)(packet.indirectOffset + packet.first * ELEMENTS_COMMAND_SIZE), packet.count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        break;
+    case DrawKind::MultiArraysIndirect:
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirectBuffer);
+        glMultiDrawArraysIndirect(packet.mode, (void*)(packet.indirectOffset + packet.first * ARRAYS_COMMAND_SIZE), packet.count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        break;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <GL/gl3w.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+// passes of the main view, submitted in this order; each is one range of the sorted queue
+enum class RenderPass : uint8_t {
+    Opaque,         // terrain, grass, player
+    FoliageDepth,   // optional depth prepass for the props
+    Foliage,        // props
+    Transparent,    // water
+    Count
+};
+
+// fixed-function state a pass is drawn with, applied through gl_state.h when it starts
+struct PassState {
+    bool colorWrite = true;
+    bool depthWrite = true;
+    GLenum depthFunc = GL_LESS;
+    GLenum blendSource = GL_SRC_ALPHA;
+    GLenum blendDestination = GL_ONE_MINUS_SRC_ALPHA;
+};
+
+struct TextureBinding {
+    GLuint unit = 0;
+    GLenum target = GL_TEXTURE_2D;
+    GLuint texture = 0;
+};
+
+enum class DrawKind : uint8_t {
+    Arrays,                 // glDrawArraysInstanced(mode, first, count, instanceCount)
+    Elements,               // glDrawElementsInstancedBaseVertex, first counts indices
+    MultiElementsIndirect,  // glMultiDrawElementsIndirect, count commands from first in indirectBuffer
+    MultiArraysIndirect     // glMultiDrawArraysIndirect, likewise
+};
+
+// One draw and the state it needs. Subsystems fill these in their Submit and the queue
+// owns the order; everything the key does not say stays in the packet.
+struct DrawPacket {
+    static const int MAX_TEXTURES = 3;
+
+    const ShaderProgram* program = nullptr;
+    GLuint vertexArray = 0;
+    TextureBinding textures[MAX_TEXTURES];
+    int textureCount = 0;
+    int model = -1;             // RenderQueue::AddModel index, set as the "model" uniform
+
+    DrawKind kind = DrawKind::Arrays;
+    GLenum mode = GL_TRIANGLES;
+    GLint first = 0;
+    GLsizei count = 0;
+    GLsizei instanceCount = 1;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLint baseVertex = 0;
+    GLuint firstInstance = 0;   // for beforeDraw; the draw call itself starts at instance 0
+    GLuint indirectBuffer = 0;
+    GLintptr indirectOffset = 0;    // where command 0 starts in indirectBuffer
+
+    // state the queue does not know about, e.g. instance attributes moved to firstInstance
+    // where base instance is missing; called with the packet's vertex array bound
+    void (*beforeDraw)(const void* owner, const DrawPacket& packet) = nullptr;
+    const void* owner = nullptr;
+
+    void AddTexture(GLuint unit, GLenum target, GLuint texture);
+};
+
+// Per-frame list of draw packets behind 64-bit sort keys. From the top bit down a key
+// holds the pass, then for opaque passes program, first texture and vertex array above
+// the distance, so state changes are grouped and ties go front to back for early-Z; the
+// transparent pass puts the inverted distance first and draws back to front. Keys are
+// radix sorted with their packet index, stable, so equal keys keep submission order.
+class RenderQueue {
+public:
+    // clears last frame's packets; distances are measured from viewPos and scaled to farPlane
+    void Begin(const glm::vec3& viewPos, float farPlane);
+    float GetViewDistance(const glm::vec3& point) const;
+    int AddModel(const glm::mat4& model);
+    // packets whose program is not ready yet are dropped
+    void Add(RenderPass pass, const DrawPacket& packet, float viewDistance = 0.0f);
+    void Sort();
+
+    void SetPassState(RenderPass pass, const PassState& state);
+    // after Sort; leaves the pass's PassState in place
+    void Submit(RenderPass pass);
+    // GL draw calls made by Submit since Begin
+    int GetDrawCount() const { return drawCount; }
+
+private:
+    struct SortItem {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    uint64_t MakeKey(RenderPass pass, const DrawPacket& packet, float viewDistance) const;
+    void Draw(const DrawPacket& packet);
+
+    std::vector<DrawPacket> packets;
+    std::vector<glm::mat4> models;
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+    PassState passStates[static_cast<int>(RenderPass::Count)];
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    float farPlane = 1.0f;
+    int drawCount = 0;
+};
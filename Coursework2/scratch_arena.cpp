@@ -0,0 +1,56 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace {
+
+const size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+}
+
+ScratchArena::~ScratchArena() {
+    FreeBlocks();
+}
+
+void ScratchArena::Reset() {
+    if (blocks.size() > 1) {
+        size_t total = GetCapacity();
+        FreeBlocks();
+        blocks.push_back({ static_cast<char*>(::operator new(total)), total });
+    }
+    used = 0;
+}
+
+size_t ScratchArena::GetCapacity() const {
+    size_t total = 0;
+    for (const auto& block : blocks)
+        total += block.size;
+    return total;
+}
+
+void* ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+    if (!blocks.empty()) {
+        Block& block = blocks.back();
+        uintptr_t start = reinterpret_cast<uintptr_t>(block.data) + used;
+        uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        size_t end = used + (aligned - start) + bytes;
+        if (end <= block.size) {
+            used = end;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
+
+    size_t size = std::max({ bytes + alignment, MIN_BLOCK_SIZE, blocks.empty() ? 0 : blocks.back().size * 2 });
+    blocks.push_back({ static_cast<char*>(::operator new(size)), size });
+    uintptr_t start = reinterpret_cast<uintptr_t>(blocks.back().data);
+    uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    used = (aligned - start) + bytes;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void ScratchArena::FreeBlocks() {
+    for (const auto& block : blocks)
+        ::operator delete(block.data);
+    blocks.clear();
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for load-time temporaries. Deallocation is a no-op; Reset rewinds
+// to the start so the next asset reuses the same memory, merging any overflow blocks
+// into one so steady-state loads touch a single allocation.
+class ScratchArena : public std::pmr::memory_resource {
+public:
+    ScratchArena() = default;
+    ~ScratchArena();
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    void Reset();
+    size_t GetCapacity() const;
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    void FreeBlocks();
+
+    std::vector<Block> blocks;
+    size_t used = 0;        // bytes taken from the last block
+};
@@ -1,30 +1,464 @@
 // shader.cpp
 #include "shader.h"
 #include "file.h"
+#include "asset_pack.h"
+#include "frame_data.h"
+#include "gl_caps.h"
+#include "gl_state.h"
+#include "mapped_file.h"
+#include "program_cache.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <glm/gtc/type_ptr.hpp>
 
-GLuint CompileShader(const char* vsFilename, const char* fsFilename)
+static std::string globalDefines;
+
+// insert #define lines straight after the #version directive, which has to stay first,
+// and a #line so messages keep the file's own line numbers
+static std::string InjectDefines(std::string code, const std::string& defines)
+{
+    if (defines.empty())
+        return code;
+
+    size_t insertAt = 0;
+    int nextLine = 1;
+    if (code.compare(0, 8, "#version") == 0) {
+        insertAt = code.find('\n');
+        insertAt = insertAt == std::string::npos ? code.size() : insertAt + 1;
+        nextLine = 2;
+    }
+    return code.substr(0, insertAt) + defines + "\n#line " + std::to_string(nextLine) + " 0\n" + code.substr(insertAt);
+}
+
+// source from the asset pack's mapping when it has the file, otherwise read from disk
+static std::string LoadShaderSource(const char* filename)
+{
+    const AssetPack& pack = GetAssetPack();
+    if (const PackEntry* entry = pack.FindEntry(filename, PackEntryType::Shader))
+        return std::string(reinterpret_cast<const char*>(pack.GetEntryData(*entry)));
+
+    char* source = read_file(filename);
+    if (!source) {
+        std::cerr << "Failed to read shader: " << filename << std::endl;
+        return std::string();
+    }
+    std::string code = source;
+    free(source);
+    return code;
+}
+
+// issues both compiles and the link without asking for any status, so a driver with
+// parallel compile can work on them in the background. The shaders stay attached for
+// their info logs; retrievable: keep the program's binary around for glGetProgramBinary.
+// A compute program has no fragment stage and its shader takes the vertex slot
+static GLuint IssueProgram(const std::string& vertexCode, const std::string& fragmentCode, bool isCompute, bool retrievable,
+    GLuint& vertexShader, GLuint& fragmentShader)
 {
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    char* vertexShaderSource = read_file(vsFilename);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+    vertexShader = glCreateShader(isCompute ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER);
+    const char* vertexCodePtr = vertexCode.c_str();
+    glShaderSource(vertexShader, 1, &vertexCodePtr, NULL);
     glCompileShader(vertexShader);
 
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    char* fragmentShaderSource = read_file(fsFilename);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
+    fragmentShader = 0;
+    if (!isCompute) {
+        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        const char* fragmentCodePtr = fragmentCode.c_str();
+        glShaderSource(fragmentShader, 1, &fragmentCodePtr, NULL);
+        glCompileShader(fragmentShader);
+    }
 
     unsigned int program = glCreateProgram();
     glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
+    if (fragmentShader)
+        glAttachShader(program, fragmentShader);
+    if (retrievable)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(program);
 
-    free(fragmentShaderSource);
-    free(vertexShaderSource);
+    return program;
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+static void ReleaseShaders(GLuint program, GLuint vertexShader, GLuint fragmentShader)
+{
+    for (GLuint shader : { vertexShader, fragmentShader }) {
+        if (shader) {
+            glDetachShader(program, shader);
+            glDeleteShader(shader);
+        }
+    }
+}
 
-    return program;
+static void PrintShaderLog(GLuint shader, const std::string& filename)
+{
+    GLint compiled = GL_TRUE, length = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled)
+        return;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::string log(std::max(length, 1), '\0');
+    glGetShaderInfoLog(shader, length, nullptr, &log[0]);
+    std::cerr << "Failed to compile " << filename << ":\n" << log.c_str() << std::endl;
+}
+
+// true when the program linked; otherwise prints the compile logs of the stages that
+// failed and the link log. Waits for the driver if the link is still running
+static bool CheckProgram(GLuint program, GLuint vertexShader, GLuint fragmentShader,
+    const std::string& vsFilename, const std::string& fsFilename)
+{
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked)
+        return true;
+
+    if (vertexShader)
+        PrintShaderLog(vertexShader, vsFilename);
+    if (fragmentShader)
+        PrintShaderLog(fragmentShader, fsFilename);
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::string log(std::max(length, 1), '\0');
+    glGetProgramInfoLog(program, length, nullptr, &log[0]);
+    std::cerr << "Failed to link " << vsFilename << " / " << fsFilename << ":\n" << log.c_str() << std::endl;
+    return false;
+}
+
+// the file with each #include "name" line replaced by that file, found next to the file
+// including it. A file is included once per stage, so shared files need no guards.
+// #line directives number the files in the order of files, which is the source string
+// number compilers put in front of line numbers in their messages
+static std::string PreprocessShader(const std::string& filename, std::vector<std::string>& files)
+{
+    std::string index = std::to_string(files.size());
+    files.push_back(filename);
+    std::string directory = filename.substr(0, filename.find_last_of('/') + 1);
+
+    std::istringstream lines(LoadShaderSource(filename.c_str()));
+    std::string code = files.size() > 1 ? "#line 1 " + index + "\n" : std::string();
+    std::string line;
+    for (int lineNumber = 1; std::getline(lines, line); lineNumber++) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            code += line;
+            code += '\n';
+            continue;
+        }
+
+        size_t open = line.find('"', start);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            std::cerr << filename << "(" << lineNumber << "): expected #include \"file\"" << std::endl;
+            continue;
+        }
+        std::string path = directory + line.substr(open + 1, close - open - 1);
+        if (std::find(files.begin(), files.end(), path) == files.end())
+            code += PreprocessShader(path, files);
+        code += "#line " + std::to_string(lineNumber + 1) + " " + index + "\n";
+    }
+    return code;
+}
+
+// full source of one stage, and in label the file name followed by its includes by
+// source string number, for messages
+static std::string BuildShaderSource(const char* filename, const std::string& defines, std::string& label)
+{
+    std::vector<std::string> files;
+    std::string code = InjectDefines(PreprocessShader(filename, files), defines);
+    label = filename;
+    for (size_t i = 1; i < files.size(); i++)
+        label += (i == 1 ? " (" : ", ") + std::to_string(i) + ": " + files[i] + (i + 1 == files.size() ? ")" : "");
+    return code;
+}
+
+void SetGlobalShaderDefines(const std::string& defines)
+{
+    globalDefines = defines;
+}
+
+enum class ProgramState { Compiling, Ready, Failed };
+
+struct Uniform {
+    uint32_t id;
+    GLint location;
+};
+
+// a setter called before the program was ready; type is the GL uniform type
+struct PendingUniform {
+    uint32_t id;
+    GLenum type;
+    int intValue;
+    glm::mat4 floatValues;
+};
+
+// one program per (vs, fs, defines); uniform values live in the program, so every
+// ShaderProgram loaded from the same tuple sees what the others set
+struct ShaderProgram::Shared {
+    std::string name;
+    std::string vsFilename, fsFilename;             // with their includes, for messages
+    GLuint program = 0;
+    GLuint vertexShader = 0, fragmentShader = 0;    // released once the link is checked
+    uint64_t key = 0;                               // binary cache key
+    bool retrievable = false;                       // save the binary once linked
+    ProgramState state = ProgramState::Compiling;
+    int users = 0;
+    std::vector<Uniform> uniforms;                  // sorted by id
+    std::vector<PendingUniform> pending;
+};
+
+static std::unordered_map<std::string, ShaderProgram::Shared> programs;
+static ShaderStats shaderStats;
+
+static void ApplyUniform(GLint location, GLenum type, int intValue, const float* values)
+{
+    switch (type) {
+    case GL_INT: glUniform1i(location, intValue); break;
+    case GL_FLOAT: glUniform1f(location, values[0]); break;
+    case GL_FLOAT_VEC2: glUniform2fv(location, 1, values); break;
+    case GL_FLOAT_VEC3: glUniform3fv(location, 1, values); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, values); break;
+    }
+}
+
+static GLint FindLocation(const ShaderProgram::Shared& shared, uint32_t id)
+{
+    auto found = std::lower_bound(shared.uniforms.begin(), shared.uniforms.end(), id, [](const Uniform& uniform, uint32_t key) { return uniform.id < key; });
+    return found != shared.uniforms.end() && found->id == id ? found->location : -1;
+}
+
+static void ReadUniforms(ShaderProgram::Shared& shared)
+{
+    GLuint program = shared.program;
+    GLuint frameData = glGetUniformBlockIndex(program, "FrameData");
+    if (frameData != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, frameData, FRAME_DATA_BINDING);
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(std::max(maxLength, 1));
+    std::vector<Uniform>& uniforms = shared.uniforms;
+    uniforms.clear();
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(i), maxLength, &length, &size, &type, name.data());
+        std::string uniformName(name.data(), length);
+        // arrays are reported as "name[0]" and set from their first element
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            uniformName.resize(uniformName.size() - 3);
+        // members of uniform blocks have no location
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        if (location < 0)
+            continue;
+        uniforms.push_back({ UniformId(uniformName.c_str()), location });
+    }
+    std::sort(uniforms.begin(), uniforms.end(), [](const Uniform& a, const Uniform& b) { return a.id < b.id; });
+    for (size_t i = 1; i < uniforms.size(); i++) {
+        if (uniforms[i].id == uniforms[i - 1].id)
+            std::cerr << "Uniform name hash collision in " << shared.vsFilename << " / " << shared.fsFilename << std::endl;
+    }
+}
+
+static void FinishProgram(ShaderProgram::Shared& shared)
+{
+    if (shared.state != ProgramState::Compiling)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    bool linked = CheckProgram(shared.program, shared.vertexShader, shared.fragmentShader, shared.vsFilename, shared.fsFilename);
+    ReleaseShaders(shared.program, shared.vertexShader, shared.fragmentShader);
+    shared.vertexShader = shared.fragmentShader = 0;
+    if (!linked) {
+        shared.state = ProgramState::Failed;
+        shared.pending.clear();
+        shaderStats.failed++;
+        return;
+    }
+
+    if (shared.retrievable)
+        SaveProgramBinary(shared.name, shared.key, shared.program);
+    ReadUniforms(shared);
+
+    // what owners set while the program was compiling, e.g. sampler units from their Init
+    if (!shared.pending.empty()) {
+        GLuint previous = GetCurrentProgram();
+        UseProgram(shared.program);
+        for (const PendingUniform& uniform : shared.pending) {
+            GLint location = FindLocation(shared, uniform.id);
+            if (location >= 0)
+                ApplyUniform(location, uniform.type, uniform.intValue, &uniform.floatValues[0][0]);
+        }
+        UseProgram(previous);
+        shared.pending.clear();
+    }
+    shared.state = ProgramState::Ready;
+    shaderStats.finishMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static ShaderProgram::Shared* AcquireProgram(const char* vsFilename, const char* fsFilename, bool isCompute, const char* defines)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string allDefines = globalDefines + (defines ? defines : "");
+    std::string name = std::string(vsFilename) + "|" + (fsFilename ? fsFilename : "") + "|" + allDefines;
+    auto found = programs.find(name);
+    if (found != programs.end()) {
+        found->second.users++;
+        shaderStats.shared++;
+        return &found->second;
+    }
+
+    ShaderProgram::Shared& shared = programs[name];
+    shared.name = name;
+    shared.users = 1;
+
+    // included files are part of the source, so editing one changes the binary cache key
+    std::string vertexCode = BuildShaderSource(vsFilename, allDefines, shared.vsFilename);
+    std::string fragmentCode = !isCompute ? BuildShaderSource(fsFilename, allDefines, shared.fsFilename) : std::string();
+    static const uint64_t driverHash = GetDriverHash();
+    std::string keySource = vertexCode + '\0' + fragmentCode + '\0' + std::to_string(driverHash);
+    shared.key = HashBytes(reinterpret_cast<const unsigned char*>(keySource.data()), keySource.size());
+
+    // a restored binary is already linked, so it is finished straight away
+    shared.program = LoadProgramBinary(name, shared.key);
+    if (shared.program) {
+        shaderStats.fromBinary++;
+        FinishProgram(shared);
+    }
+    else {
+        shared.retrievable = GetGLCaps().programBinary;
+        shared.program = IssueProgram(vertexCode, fragmentCode, isCompute, shared.retrievable, shared.vertexShader, shared.fragmentShader);
+        shaderStats.compiled++;
+    }
+
+    shaderStats.issueMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return &shared;
+}
+
+static void ReleaseProgram(ShaderProgram::Shared* shared)
+{
+    if (!shared || --shared->users > 0)
+        return;
+    ReleaseShaders(shared->program, shared->vertexShader, shared->fragmentShader);
+    glDeleteProgram(shared->program);
+    programs.erase(shared->name);
+}
+
+const ShaderStats& GetShaderStats()
+{
+    return shaderStats;
+}
+
+int PollShaderPrograms()
+{
+    bool parallel = GetGLCaps().parallelShaderCompile;
+    int compiling = 0;
+    for (auto& entry : programs) {
+        ShaderProgram::Shared& shared = entry.second;
+        if (shared.state != ProgramState::Compiling)
+            continue;
+        GLint done = GL_TRUE;
+        if (parallel)
+            glGetProgramiv(shared.program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done)
+            FinishProgram(shared);
+        else
+            compiling++;
+    }
+    return compiling;
+}
+
+void ShaderProgram::Load(const char* vsFilename, const char* fsFilename, const char* defines)
+{
+    shared = AcquireProgram(vsFilename, fsFilename, false, defines);
+}
+
+void ShaderProgram::LoadCompute(const char* csFilename, const char* defines)
+{
+    shared = AcquireProgram(csFilename, nullptr, true, defines);
+}
+
+bool ShaderProgram::IsReady() const
+{
+    return shared && shared->state == ProgramState::Ready;
+}
+
+void ShaderProgram::WaitUntilReady() const
+{
+    if (shared)
+        FinishProgram(*shared);
+}
+
+void ShaderProgram::Use() const
+{
+    if (IsReady())
+        UseProgram(shared->program);
+}
+
+GLuint ShaderProgram::GetId() const
+{
+    return shared ? shared->program : 0;
+}
+
+GLint ShaderProgram::GetLocation(uint32_t id) const
+{
+    return IsReady() ? FindLocation(*shared, id) : -1;
+}
+
+// acts on the program in use once ready; before that keeps the last value per uniform
+static void SetUniform(ShaderProgram::Shared* shared, uint32_t id, GLenum type, int intValue, const float* values, int count)
+{
+    if (!shared)
+        return;
+    if (shared->state == ProgramState::Ready) {
+        GLint location = FindLocation(*shared, id);
+        if (location >= 0)
+            ApplyUniform(location, type, intValue, values);
+        return;
+    }
+    if (shared->state == ProgramState::Failed)
+        return;
+
+    auto found = std::find_if(shared->pending.begin(), shared->pending.end(), [id](const PendingUniform& uniform) { return uniform.id == id; });
+    if (found == shared->pending.end())
+        found = shared->pending.insert(shared->pending.end(), PendingUniform{ id, type, 0, glm::mat4(0.0f) });
+    found->type = type;
+    found->intValue = intValue;
+    if (values)
+        std::copy(values, values + count, &found->floatValues[0][0]);
+}
+
+void ShaderProgram::SetInt(uint32_t id, int value) const
+{
+    SetUniform(shared, id, GL_INT, value, nullptr, 0);
+}
+
+void ShaderProgram::SetFloat(uint32_t id, float value) const
+{
+    SetUniform(shared, id, GL_FLOAT, 0, &value, 1);
+}
+
+void ShaderProgram::SetVec2(uint32_t id, const glm::vec2& value) const
+{
+    SetUniform(shared, id, GL_FLOAT_VEC2, 0, glm::value_ptr(value), 2);
+}
+
+void ShaderProgram::SetVec3(uint32_t id, const glm::vec3& value) const
+{
+    SetUniform(shared, id, GL_FLOAT_VEC3, 0, glm::value_ptr(value), 3);
+}
+
+void ShaderProgram::SetMat4(uint32_t id, const glm::mat4& value) const
+{
+    SetUniform(shared, id, GL_FLOAT_MAT4, 0, glm::value_ptr(value), 16);
+}
+
+void ShaderProgram::Cleanup()
+{
+    ReleaseProgram(shared);
+    shared = nullptr;
 }
@@ -1,6 +1,82 @@
 // shader.h
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
 #include <GL/gl3w.h>
+#include <glm/glm.hpp>
 
-GLuint CompileShader(const char* vsFilename, const char* fsFilename);
+// Shader sources may #include "file" (relative to the including file) and are compiled
+// with "#define NAME [value]" lines inserted after #version: the global defines below,
+// then the ones passed with the program. Variants of one file are separate programs,
+// built at load time, so shaders pick features with #ifdef rather than uniforms.
+
+// defines for every program loaded afterwards, for options of the whole scene such as
+// the shadow filter; set before the first Load
+void SetGlobalShaderDefines(const std::string& defines);
+
+// programs handed out by ShaderProgram::Load so far and the time spent building them
+struct ShaderStats {
+    int shared = 0;         // loads answered with a program another ShaderProgram already holds
+    int fromBinary = 0;     // programs restored from a cached binary (program_cache.h)
+    int compiled = 0;       // programs compiled and linked from source
+    int failed = 0;         // programs that did not link; their passes never run
+    double issueMilliseconds = 0.0;     // spent inside Load, issuing compiles and restoring binaries
+    double finishMilliseconds = 0.0;    // spent finishing programs, mostly waiting on links still running
+};
+
+const ShaderStats& GetShaderStats();
+
+// Finishes programs whose compile and link are done: checks them, printing info logs on
+// failure, and reads back their uniforms. With KHR/ARB_parallel_shader_compile it only
+// takes programs whose COMPLETION_STATUS is set and never waits; without, it finishes
+// every pending program, waiting on the driver. Returns how many are still compiling.
+// Once per frame on the GL thread.
+int PollShaderPrograms();
+
+// FNV-1a of a uniform name. constexpr, so UniformId("MVP") in draw code is folded to a
+// constant and no string is touched per frame
+constexpr uint32_t UniformId(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+    return hash;
+}
+
+// A linked program and the locations of all its active uniforms, read back once at link
+// time. Setters act on the program in use and skip uniforms the linker dropped, like a
+// location of -1 does. A FrameData block (frame_data.h) is bound when the program has one.
+// Loads of the same (vs, fs, defines) share one GL program, deleted when the last of them
+// is cleaned up.
+//
+// Load only issues the compile. Until IsReady, Use does nothing and setters are recorded
+// (the last value per uniform) and applied when PollShaderPrograms finishes the program,
+// so constants can still be set right after Load; draw code skips its pass instead.
+class ShaderProgram {
+public:
+    void Load(const char* vsFilename, const char* fsFilename, const char* defines = nullptr);
+    // GL 4.3 compute shaders; dispatched after Use like any other program
+    void LoadCompute(const char* csFilename, const char* defines = nullptr);
+    bool IsReady() const;
+    // finishes this program now, waiting on the driver, for code that draws straight away
+    void WaitUntilReady() const;
+    void Use() const;
+    GLuint GetId() const;
+    // -1 when the program has no active uniform by that name, or is not ready
+    GLint GetLocation(uint32_t id) const;
+
+    void SetInt(uint32_t id, int value) const;
+    void SetFloat(uint32_t id, float value) const;
+    void SetVec2(uint32_t id, const glm::vec2& value) const;
+    void SetVec3(uint32_t id, const glm::vec3& value) const;
+    void SetMat4(uint32_t id, const glm::mat4& value) const;
+
+    void Cleanup();
+
+    struct Shared;          // registry entry, see shader.cpp
+
+private:
+    Shared* shared = nullptr;
+};
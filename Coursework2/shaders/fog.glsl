@@ -0,0 +1,6 @@
+// Distance fog, after frame_data.glsl. Scene shaders apply it themselves with
+// FOG_IN_SHADER; otherwise fog_post.frag applies it to the finished frame.
+vec3 ApplyFog(vec3 color, vec3 worldPos) {
+    float fogFactor = clamp(1.0 - exp(-length(viewPos - worldPos) * fogDensity), 0.0, 1.0);
+    return mix(color, fogColor, fogFactor);
+}
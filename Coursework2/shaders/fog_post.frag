@@ -1,13 +1,13 @@
 #version 330 core
+
+#include "frame_data.glsl"
+#include "fog.glsl"
+
 in vec2 TexCoords;
 out vec4 FragColor;
 
 uniform sampler2D scene;
 uniform sampler2D depthMap;
-uniform vec3 fogColor;
-uniform vec3 camPos;
-uniform mat4 invProj;
-uniform mat4 invView;
 
 void main() {
     float rawDepth = texture(depthMap, TexCoords).r;
@@ -20,19 +20,13 @@ void main() {
 
     vec4 clipSpace = vec4(TexCoords * 2.0 - 1.0, rawDepth * 2.0 - 1.0, 1.0);
 
-    vec4 viewPos = invProj * clipSpace;
-    viewPos /= viewPos.w;
-
-    vec4 worldPos = invView * viewPos;
-
-    float dist = length(camPos - worldPos.xyz);
+    vec4 viewSpacePos = inverseProjection * clipSpace;
+    viewSpacePos /= viewSpacePos.w;
 
-    float fogDensity = 0.002;
-    float fogFactor = 1.0 - exp(-dist * fogDensity);
-    fogFactor = clamp(fogFactor, 0.0, 1.0);
+    vec4 worldPos = inverseView * viewSpacePos;
 
     vec3 sceneColor = texture(scene, TexCoords).rgb;
-    vec3 finalColor = mix(sceneColor, fogColor, fogFactor);
+    vec3 finalColor = ApplyFog(sceneColor, worldPos.xyz);
 
     FragColor = vec4(finalColor, 1.0);
 }
@@ -0,0 +1,5 @@
+// cutout test for foliage textures, shared by the color and depth passes so both discard
+// the same fragments
+bool IsCutOut(vec4 texSample) {
+    return texSample.a < 0.1 || length(texSample.rgb) > 1.0;
+}
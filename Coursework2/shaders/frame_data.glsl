@@ -0,0 +1,16 @@
+// per-frame camera, sun, shadow and fog values, see frame_data.h
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    mat4 inverseProjection;
+    mat4 inverseView;
+    mat4 lightSpaceMatrix;
+    vec3 viewPos;
+    float sunElevation;
+    vec3 lightDir;
+    float time;
+    vec3 lightColor;
+    float fogDensity;
+    vec3 fogColor;
+};
@@ -0,0 +1,34 @@
+#version 330 core
+
+#include "frame_data.glsl"
+
+// single tap is enough for thin blades
+#undef PCF_RADIUS
+#define PCF_RADIUS 0
+#include "shadow.glsl"
+#include "fog.glsl"
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec3 BladeColor;
+
+out vec4 FragColor;
+
+void main() {
+    vec3 ambient = 0.2 * lightColor;
+    vec3 norm = -normalize(Normal);
+    vec3 lightDirNorm = normalize(lightDir);
+    float diff = max(dot(norm, lightDirNorm), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+    float shadow = ShadowCalc(FragPos, 0.002);
+
+    float sunlight = clamp(-sunElevation, 0.0, 1.0);
+    vec3 lighting = ambient * BladeColor;
+    lighting += (1.0 - shadow) * diffuse * BladeColor * sunlight;
+
+#ifdef FOG_IN_SHADER
+    lighting = ApplyFog(lighting, FragPos);
+#endif
+    FragColor = vec4(lighting, 1.0);
+}
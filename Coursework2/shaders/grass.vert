@@ -0,0 +1,98 @@
+#version 330 core
+
+#include "frame_data.glsl"
+
+layout(location = 0) in ivec2 patchCoord;
+
+uniform float patchSize;
+uniform float worldSize;
+uniform int bladesPerPatch;
+uniform float fadeDistance;
+uniform sampler2D heightMap;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 BladeColor;
+
+uint HashU(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+float Rand(inout uint state) {
+    state = HashU(state);
+    return float(state & 0xFFFFFFU) / 16777216.0;
+}
+
+float TerrainHeight(vec2 xz) {
+    return texture(heightMap, (xz + 0.5) / (worldSize + 1.0)).r;
+}
+
+void main() {
+    int blade = gl_VertexID / 3;
+    int corner = gl_VertexID % 3;
+
+    // every blade is a pure function of its patch and index, so recycled patches need no upload
+    uint state = HashU(uint(patchCoord.x) * 73856093U ^ uint(patchCoord.y) * 19349663U ^ uint(blade) * 83492791U);
+    vec2 xz = (vec2(patchCoord) + vec2(Rand(state), Rand(state))) * patchSize;
+
+    float height = TerrainHeight(xz);
+    float hL = TerrainHeight(xz - vec2(1.0, 0.0));
+    float hR = TerrainHeight(xz + vec2(1.0, 0.0));
+    float hD = TerrainHeight(xz - vec2(0.0, 1.0));
+    float hU = TerrainHeight(xz + vec2(0.0, 1.0));
+    vec3 terrainNormal = normalize(vec3(hL - hR, 2.0, hD - hU));
+
+    // same height and slope rules tile.frag uses to blend sand, grass and stone
+    float heightFactor = smoothstep(-4.0, -1.0, height);
+    float steepness = smoothstep(0.99, 0.7, abs(terrainNormal.y));
+    float coverage = heightFactor * (1.0 - steepness);
+
+    // distance LOD: thin out blades by index so far patches keep a shrinking prefix
+    float dist = length(xz - viewPos.xz);
+    float density = 1.0 - smoothstep(fadeDistance * 0.3, fadeDistance, dist);
+    float bladeRank = float(blade) / float(bladesPerPatch);
+
+    bool inside = all(greaterThanEqual(xz, vec2(0.0))) && all(lessThanEqual(xz, vec2(worldSize)));
+    if (!inside || bladeRank >= density || Rand(state) >= coverage) {
+        // collapse to a degenerate triangle outside the clip volume
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        FragPos = vec3(0.0);
+        Normal = vec3(0.0, 1.0, 0.0);
+        BladeColor = vec3(0.0);
+        return;
+    }
+
+    float angle = Rand(state) * 6.2831853;
+    float bladeHeight = mix(0.35, 0.9, Rand(state)) * mix(0.6, 1.0, density);
+    float bladeWidth = 0.08;
+    vec2 side = vec2(cos(angle), sin(angle));
+
+    vec3 root = vec3(xz.x, height, xz.y);
+    vec3 pos = root;
+    float tip = 0.0;
+    if (corner == 0) pos.xz -= side * bladeWidth * 0.5;
+    else if (corner == 1) pos.xz += side * bladeWidth * 0.5;
+    else {
+        tip = 1.0;
+        pos.y += bladeHeight;
+    }
+
+    // wind, same sway as tree.vert driven by height along the blade
+    float swayStrength = 0.25;
+    float swaySpeed = 1.0;
+    float swayOffset = sin(time * swaySpeed + root.x * 0.5 + root.z * 0.5) * swayStrength * tip;
+    pos.x += swayOffset;
+
+    vec3 baseColor = vec3(0.10, 0.22, 0.05);
+    vec3 tipColor = mix(vec3(0.35, 0.50, 0.15), vec3(0.45, 0.45, 0.18), Rand(state));
+
+    FragPos = pos;
+    Normal = terrainNormal;
+    BladeColor = mix(baseColor, tipColor, tip);
+    gl_Position = viewProjection * vec4(pos, 1.0);
+}
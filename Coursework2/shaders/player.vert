@@ -1,11 +1,11 @@
 #version 330 core
 
+#include "frame_data.glsl"
+
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 
 uniform mat4 model;
-uniform mat4 MVP;
-uniform mat4 lightSpaceMatrix;
 
 out vec3 FragPos;
 out vec3 Normal;
@@ -13,5 +13,5 @@ out vec3 Normal;
 void main() {
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
-    gl_Position = MVP * vec4(aPos, 1.0);
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,41 @@
+// Sun shadow lookup for the lit scene shaders, after frame_data.glsl. Without SHADOWS
+// nothing is shadowed and the shadow map is not sampled. PCF_RADIUS sets the filter:
+// 0 is a single tap, 1 a 3x3 kernel, 2 a 5x5 one; the loops have constant bounds.
+
+#ifndef PCF_RADIUS
+#define PCF_RADIUS 1
+#endif
+
+#ifdef SHADOWS
+uniform sampler2D shadowMap;
+#endif
+
+// more bias where the surface turns away from the light
+float ShadowBias(vec3 normal, vec3 lightDir) {
+    return max(0.001 * (1.0 - dot(normal, lightDir)), 0.001);
+}
+
+// 0 lit, 1 fully shadowed
+float ShadowCalc(vec3 worldPos, float bias) {
+#ifdef SHADOWS
+    vec4 fragPosLightSpace = lightSpaceMatrix * vec4(worldPos, 1.0);
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+    projCoords = projCoords * 0.5 + 0.5;
+    if (projCoords.z > 1.0)
+        return 0.0;
+
+    float currentDepth = projCoords.z - bias;
+#if PCF_RADIUS == 0
+    return currentDepth > texture(shadowMap, projCoords.xy).r ? 1.0 : 0.0;
+#else
+    float shadow = 0.0;
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    for (int x = -PCF_RADIUS; x <= PCF_RADIUS; ++x)
+        for (int y = -PCF_RADIUS; y <= PCF_RADIUS; ++y)
+            shadow += currentDepth > texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r ? 1.0 : 0.0;
+    return shadow / float((2 * PCF_RADIUS + 1) * (2 * PCF_RADIUS + 1));
+#endif
+#else
+    return 0.0;
+#endif
+}
@@ -1,7 +1,9 @@
 #version 330 core
+
+#include "frame_data.glsl"
+
 layout(location = 0) in vec3 aPos;
-uniform mat4 model;
-uniform mat4 lightSpaceMatrix;
+layout(location = 3) in mat4 instanceModel;
 void main() {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * instanceModel * vec4(aPos, 1.0);
 }
@@ -0,0 +1,17 @@
+#version 330 core
+in vec2 TexCoords;
+out vec4 FragColor;
+
+uniform sampler2D image;
+uniform float lod;
+uniform vec2 scale;     // viewport size over the sampled level's size, one texel per pixel
+
+void main() {
+    // taps spread over the image so each one streams its own part of the texture
+    vec2 uv = TexCoords * scale;
+    vec4 sum = textureLod(image, uv, lod);
+    sum += textureLod(image, uv + vec2(0.25, 0.5), lod);
+    sum += textureLod(image, uv + vec2(0.5, 0.25), lod);
+    sum += textureLod(image, uv + vec2(0.75, 0.75), lod);
+    FragColor = sum * 0.25;
+}
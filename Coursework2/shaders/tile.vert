@@ -1,10 +1,11 @@
 #version 330 core
 
+#include "frame_data.glsl"
+
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aUV;
 
-uniform mat4 MVP;
 uniform mat4 model;
 
 out vec3 worldPosition;
@@ -17,5 +18,5 @@ void main() {
     Normal = mat3(transpose(inverse(model))) * aNormal;
     FragPos = worldPosition.xyz;
     UV = aUV;
-    gl_Position = MVP * vec4(aPos, 1.0);
+    gl_Position = viewProjection * vec4(worldPosition, 1.0);
 }
@@ -1,16 +1,20 @@
 #version 330 core
+
+#include "frame_data.glsl"
+
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aTexCoord;
 layout(location = 2) in vec3 aNormal;
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in float aLayer;
 
-uniform mat4 MVP;
-uniform mat4 model;
-uniform float time;
-uniform bool isLeaf;
+// the foliage prepass relies on identical depths in both passes
+invariant gl_Position;
 
 out vec2 TexCoord;
 out vec3 FragPos;
 out vec3 Normal;
+flat out float Layer;
 
 void main() {
     vec3 swayPosition = aPos;
@@ -24,9 +28,10 @@ void main() {
 
     swayPosition.x += swayOffset;
 
-    vec4 worldPosition = model * vec4(swayPosition, 1.0);
+    vec4 worldPosition = instanceModel * vec4(swayPosition, 1.0);
     FragPos = worldPosition.xyz;
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = mat3(transpose(inverse(instanceModel))) * aNormal;
     TexCoord = aTexCoord;
-    gl_Position = MVP * vec4(swayPosition, 1.0);
+    Layer = aLayer;
+    gl_Position = viewProjection * worldPosition;
 }
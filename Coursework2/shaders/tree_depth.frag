@@ -0,0 +1,18 @@
+#version 330 core
+
+#include "foliage.glsl"
+
+in vec2 TexCoord;
+flat in float Layer;
+
+uniform sampler2DArray treeTextures;
+
+// depth-only foliage prepass; with ALPHA_TEST the same cutout as tree.frag, without it
+// (opaque parts) there is nothing to shade
+void main() {
+#ifdef ALPHA_TEST
+    vec4 texSample = texture(treeTextures, vec3(TexCoord, Layer));
+    if (IsCutOut(texSample))
+        discard;
+#endif
+}
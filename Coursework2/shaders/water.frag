@@ -1,10 +1,12 @@
 #version 330 core
+
+#include "frame_data.glsl"
+#include "fog.glsl"
+
 in vec2 TexCoord;
+in vec3 FragPos;
 out vec4 FragColor;
 
-uniform float time;
-uniform float sunElevation;
-
 float hash(vec2 p) {
     return fract(sin(dot(p, vec2(456.3, 1123.189))) * 1928.5518);
 }
@@ -36,6 +38,9 @@ void main() {
 
     float brightness = shimmer(TexCoord, time * 2.0f);
     vec3 finalColor = baseColor + vec3(brightness);
+#ifdef FOG_IN_SHADER
+    finalColor = ApplyFog(finalColor, FragPos);
+#endif
 
     FragColor = vec4(finalColor, 0.35); 
 }
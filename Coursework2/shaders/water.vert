@@ -1,10 +1,13 @@
 #version 330 core
+
+#include "frame_data.glsl"
+
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 MVP;
-uniform float time;
+uniform mat4 model;
 
 out vec2 TexCoord;
+out vec3 FragPos;
 
 void main() {
     vec3 pos = aPos;
@@ -14,5 +17,6 @@ void main() {
 
     TexCoord = pos.xz * 0.05;
 
-    gl_Position = MVP * vec4(pos, 1.0);
+    FragPos = vec3(model * vec4(pos, 1.0));
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
 }
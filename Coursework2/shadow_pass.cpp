@@ -0,0 +1,151 @@
+#include "shadow_pass.h"
+#include "shader.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+
+void ShadowPass::Init() {
+    instances.Init(GL_ARRAY_BUFFER, 4096 * sizeof(glm::mat4));
+    shader.Load("shaders/shadow_depth.vert", "shaders/shadow_depth.frag");
+    timer.Init();
+}
+
+int ShadowPass::AddMesh(GLuint vbo, GLsizei stride, GLint firstVertex, GLsizei vertexCount) {
+    int id = CreateMesh(vbo, 0, stride);
+    meshes[id].first = firstVertex;
+    meshes[id].count = vertexCount;
+    return id;
+}
+
+int ShadowPass::AddIndexedMesh(GLuint vbo, GLuint ebo, GLsizei stride, GLuint firstIndex, GLsizei indexCount, GLint baseVertex,
+    GLenum indexType) {
+    int id = CreateMesh(vbo, ebo, stride);
+    meshes[id].indexed = true;
+    meshes[id].indexType = indexType;
+    meshes[id].first = static_cast<GLint>(firstIndex);
+    meshes[id].count = indexCount;
+    meshes[id].baseVertex = baseVertex;
+    return id;
+}
+
+int ShadowPass::CreateMesh(GLuint vbo, GLuint ebo, GLsizei stride) {
+    CasterMesh mesh;
+
+    // position only, instance attributes are pointed at the shared buffer at draw time
+    glGenVertexArrays(1, &mesh.VAO);
+    BindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (ebo != 0)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    for (int c = 0; c < 4; c++) {
+        glEnableVertexAttribArray(3 + c);
+        glVertexAttribDivisor(3 + c, 1);
+    }
+    BindVertexArray(0);
+
+    meshes.push_back(mesh);
+    return static_cast<int>(meshes.size()) - 1;
+}
+
+void ShadowPass::BeginFrame(const glm::mat4& lightView, const glm::mat4& lightProjection) {
+    this->lightView = lightView;
+    lightSpaceMatrix = lightProjection * lightView;
+
+    // orthographic extents in light view space
+    halfExtent = glm::vec2(1.0f / lightProjection[0][0], 1.0f / lightProjection[1][1]);
+    centerOffset = glm::vec2(-lightProjection[3][0], -lightProjection[3][1]) * halfExtent;
+    farPlane = (lightProjection[3][2] - 1.0f) / lightProjection[2][2];
+
+    for (auto& mesh : meshes) {
+        mesh.instances.clear();
+    }
+    tested = 0;
+}
+
+bool ShadowPass::IsVisible(const glm::vec3& center, float radius) const {
+    // only the sides and the far plane cull; anything between the light and the
+    // near plane still casts and is flattened onto it by depth clamping
+    tested++;
+    glm::vec3 c = glm::vec3(lightView * glm::vec4(center, 1.0f));
+    if (glm::abs(c.x - centerOffset.x) - radius > halfExtent.x) return false;
+    if (glm::abs(c.y - centerOffset.y) - radius > halfExtent.y) return false;
+    if (-c.z - radius > farPlane) return false;
+    return true;
+}
+
+void ShadowPass::AddInstance(int mesh, const glm::mat4& model) {
+    meshes[mesh].instances.push_back(model);
+}
+
+void ShadowPass::Render() {
+    drawn = 0;
+    for (const auto& mesh : meshes) {
+        drawn += mesh.instances.size();
+    }
+
+    // written straight into this frame's region of the ring
+    if (drawn > 0) {
+        glm::mat4* region = static_cast<glm::mat4*>(instances.Map(drawn * sizeof(glm::mat4)));
+        for (const auto& mesh : meshes) {
+            std::copy(mesh.instances.begin(), mesh.instances.end(), region);
+            region += mesh.instances.size();
+        }
+        instances.Unmap();
+    }
+
+    glClear(GL_DEPTH_BUFFER_BIT);
+    // while the program is compiling the map stays cleared and nothing is shadowed
+    if (!shader.IsReady())
+        return;
+    SetEnabled(GL_DEPTH_CLAMP, true);
+
+    timer.Begin();
+    // shadow_depth.vert reads lightSpaceMatrix from FrameData, built from the same sun view
+    // and projection as the one here that culls
+    shader.Use();
+
+    glBindBuffer(GL_ARRAY_BUFFER, instances.GetBuffer());
+    size_t offset = instances.GetOffset();
+    for (const auto& mesh : meshes) {
+        if (mesh.instances.empty())
+            continue;
+
+        BindVertexArray(mesh.VAO);
+        for (int c = 0; c < 4; c++) {
+            glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                (void*)(offset + c * sizeof(glm::vec4)));
+        }
+        GLsizei instanceCount = static_cast<GLsizei>(mesh.instances.size());
+        if (mesh.indexed) {
+            size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.count, mesh.indexType,
+                (void*)(mesh.first * indexSize), instanceCount, mesh.baseVertex);
+        }
+        else {
+            glDrawArraysInstanced(GL_TRIANGLES, mesh.first, mesh.count, instanceCount);
+        }
+        offset += mesh.instances.size() * sizeof(glm::mat4);
+    }
+    timer.End();
+
+    SetEnabled(GL_DEPTH_CLAMP, false);
+    BindVertexArray(0);
+
+    if (++frameCount % 300 == 0) {
+        std::cout << "Shadow pass: " << timer.GetAverageMs() << " ms GPU, " << drawn << " caster instances from " << tested << " tested bounds\n";
+        timer.Reset();
+    }
+}
+
+void ShadowPass::Cleanup() {
+    for (auto& mesh : meshes) {
+        glDeleteVertexArrays(1, &mesh.VAO);
+    }
+    meshes.clear();
+    instances.Cleanup();
+    shader.Cleanup();
+    timer.Cleanup();
+}
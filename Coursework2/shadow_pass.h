@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/gl3w.h>
+#include "gpu_timer.h"
+#include "shader.h"
+#include "stream_buffer.h"
+
+// Collects shadow casters every frame, culls them against the light volume and
+// draws each caster mesh once with all of its visible instances. The shadow map is a
+// render graph target, bound with its viewport before Render.
+class ShadowPass {
+public:
+    void Init();
+    int AddMesh(GLuint vbo, GLsizei stride, GLint firstVertex, GLsizei vertexCount);
+    int AddIndexedMesh(GLuint vbo, GLuint ebo, GLsizei stride, GLuint firstIndex, GLsizei indexCount, GLint baseVertex,
+        GLenum indexType = GL_UNSIGNED_INT);
+
+    void BeginFrame(const glm::mat4& lightView, const glm::mat4& lightProjection);
+    bool IsVisible(const glm::vec3& center, float radius) const;
+    void AddInstance(int mesh, const glm::mat4& model);
+    void Render();
+
+    const glm::mat4& GetLightSpaceMatrix() const { return lightSpaceMatrix; }
+    void Cleanup();
+
+private:
+    int CreateMesh(GLuint vbo, GLuint ebo, GLsizei stride);
+
+    struct CasterMesh {
+        GLuint VAO = 0;
+        bool indexed = false;
+        GLenum indexType = GL_UNSIGNED_INT;
+        GLint first = 0;            // first vertex, or first index when indexed
+        GLsizei count = 0;
+        GLint baseVertex = 0;
+        std::vector<glm::mat4> instances;
+    };
+
+    std::vector<CasterMesh> meshes;
+
+    StreamBuffer instances;     // every visible caster's matrix, mesh after mesh
+    ShaderProgram shader;
+
+    glm::mat4 lightView = glm::mat4(1.0f);
+    glm::mat4 lightSpaceMatrix = glm::mat4(1.0f);
+    glm::vec2 halfExtent = glm::vec2(0.0f);
+    glm::vec2 centerOffset = glm::vec2(0.0f);
+    float farPlane = 0.0f;
+
+    GpuTimer timer;
+    int frameCount = 0;
+    mutable size_t tested = 0;
+    size_t drawn = 0;
+};
@@ -0,0 +1,106 @@
+#include "stream_buffer.h"
+#include "gl_caps.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+StreamStats stats;
+
+size_t AlignUp(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void StreamBuffer::Init(GLenum target, size_t regionSize, size_t alignment) {
+    this->target = target;
+    this->alignment = std::max<size_t>(alignment, 1);
+    persistent = GetGLCaps().bufferStorage;
+    Allocate(regionSize);
+}
+
+void StreamBuffer::Allocate(size_t regionSize) {
+    this->regionSize = AlignUp(std::max<size_t>(regionSize, 1), alignment);
+    region = REGIONS - 1;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    GLsizeiptr total = static_cast<GLsizeiptr>(this->regionSize * REGIONS);
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, total, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(target, 0, total, flags));
+    }
+    else {
+        glBufferData(target, total, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+void StreamBuffer::Release() {
+    for (GLsync& fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (mapped) {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        mapped = nullptr;
+    }
+    // draws already queued keep the storage alive until they are done with it
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void* StreamBuffer::Map(size_t size) {
+    stats.maps++;
+    if (size > regionSize) {
+        stats.reallocations++;
+        Release();
+        Allocate(std::max(size, regionSize * 2));
+    }
+
+    // whatever reads the current region has been issued by now
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % REGIONS;
+
+    GLsync& fence = fences[region];
+    if (fence) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            auto start = std::chrono::steady_clock::now();
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            stats.waits++;
+            stats.waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    glBindBuffer(target, buffer);
+    if (persistent)
+        return mapped + GetOffset();
+    return glMapBufferRange(target, GetOffset(), static_cast<GLsizeiptr>(size),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamBuffer::Unmap() {
+    // coherent mappings need no flush; the next draw sees the writes
+    if (persistent)
+        return;
+    glBindBuffer(target, buffer);
+    glUnmapBuffer(target);
+}
+
+void StreamBuffer::Cleanup() {
+    if (buffer)
+        Release();
+}
+
+const StreamStats& GetStreamStats() {
+    return stats;
+}
+
+void ResetStreamStats() {
+    stats = StreamStats();
+}
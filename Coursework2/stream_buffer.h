@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <GL/gl3w.h>
+
+// A buffer the CPU rewrites while the GPU may still be reading an older copy: instance
+// matrices, per-frame uniforms, indirect commands. It is split into REGIONS equal
+// regions used in turn. Each Map moves on to the next region and first waits for the
+// fence left when the ring last moved off it, so a region is never overwritten while
+// queued draws still read it. With buffer storage (GL 4.4 or ARB_buffer_storage) the
+// buffer stays mapped, persistent and coherent, and Map only returns a pointer.
+// Otherwise each Map maps its region with glMapBufferRange, using the unsynchronized
+// and invalidate-range flags; the fences are what make that safe. Either way callers
+// write straight into the buffer, with no staging copy for the driver to make.
+class StreamBuffer {
+public:
+    static const int REGIONS = 3;
+
+    // regions start at multiples of alignment, e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    void Init(GLenum target, size_t regionSize, size_t alignment = 16);
+    // leaves the buffer bound to its target; a size the regions cannot hold reallocates
+    // them, after which GetBuffer returns a new name
+    void* Map(size_t size);
+    void Unmap();
+    GLuint GetBuffer() const { return buffer; }
+    // where the last mapped region starts
+    GLintptr GetOffset() const { return static_cast<GLintptr>(region * regionSize); }
+    void Cleanup();
+
+private:
+    void Allocate(size_t regionSize);
+    void Release();
+
+    GLenum target = GL_ARRAY_BUFFER;
+    size_t alignment = 16;
+    size_t regionSize = 0;
+    bool persistent = false;
+    GLuint buffer = 0;
+    unsigned char* mapped = nullptr;    // whole buffer, when persistent
+    GLsync fences[REGIONS] = {};
+    int region = REGIONS - 1;
+};
+
+// Map calls, and how often and how long they blocked on a fence, since the last reset
+struct StreamStats {
+    long long maps = 0;
+    long long waits = 0;
+    double waitMilliseconds = 0.0;
+    long long reallocations = 0;
+};
+
+const StreamStats& GetStreamStats();
+void ResetStreamStats();
@@ -21,17 +21,19 @@ void Sun::Update(float deltaTime, const glm::vec3& targetPosition) {
     color = glm::mix(glm::vec3(1.0f, 0.5f, 0.2f), glm::vec3(1.0f), daylight);
 
     glm::vec3 lightPos = targetPosition - direction * 200.0f;
-    glm::mat4 lightProj = glm::ortho(
+    lightProjection = glm::ortho(
         -worldSize * 0.6f, worldSize * 0.6f,
         -worldSize * 0.6f, worldSize * 0.6f,
         10.0f, worldSize
     );
 
-    glm::mat4 lightView = glm::lookAt(lightPos, targetPosition, glm::vec3(0.0f, 1.0f, 0.0f));
-    lightSpaceMatrix = lightProj * lightView;
+    lightView = glm::lookAt(lightPos, targetPosition, glm::vec3(0.0f, 1.0f, 0.0f));
+    lightSpaceMatrix = lightProjection * lightView;
 }
 
 const glm::vec3& Sun::GetDirection() const { return direction; }
 const glm::vec3& Sun::GetColor() const { return color; }
 const glm::mat4& Sun::GetLightSpaceMatrix() const { return lightSpaceMatrix; }
+const glm::mat4& Sun::GetLightView() const { return lightView; }
+const glm::mat4& Sun::GetLightProjection() const { return lightProjection; }
 float Sun::GetElevation() const { return elevation; }
@@ -11,6 +11,8 @@ public:
     const glm::vec3& GetDirection() const;
     const glm::vec3& GetColor() const;
     const glm::mat4& GetLightSpaceMatrix() const;
+    const glm::mat4& GetLightView() const;
+    const glm::mat4& GetLightProjection() const;
     float GetElevation() const;
 
 private:
@@ -20,6 +22,8 @@ private:
     glm::vec3 direction;
     glm::vec3 color;
     glm::mat4 lightSpaceMatrix;
+    glm::mat4 lightView;
+    glm::mat4 lightProjection;
     float elevation;
     float sunAngle = -glm::half_pi<float>();
 	int sunSpeed = 0.01; // Speed of the sun's movement
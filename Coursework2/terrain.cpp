@@ -4,93 +4,264 @@
 #include <cmath>
 #include "texture.h"
 #include "shader.h"
+#include "frame_data.h"
+#include "gl_state.h"
+#include "gl_caps.h"
 #include <iostream>
 #include <vector>
 #include <glm/gtc/type_ptr.hpp>
 #include "noise.h"
 
-void Terrain::Init(int tilesX, int tilesZ) {
-    this->tilesX = tilesX;
-    this->tilesZ = tilesZ;
-
-    cliffTexture = LoadTexture("textures/cliff_side_diff_4k.jpg");
-    grassTexture = LoadTexture("textures/rocky_terrain_02_diff_4k.jpg");
-    riverbedTexture = LoadTexture("textures/sandy_gravel_02_diff_4k.jpg");
+namespace {
 
-    std::vector<float> tileMesh = {
-        0.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 1.0f
-    };
+const int REGION_SIZE = 50;     // tiles per region side
 
-    terrainMesh = BuildTerrainMesh(tileMesh, tilesX, tilesZ);
+// layout consumed by glMultiDrawArraysIndirect
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, terrainMesh.size() * sizeof(float), terrainMesh.data(), GL_STATIC_DRAW);
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+void Terrain::Init(int tilesX, int tilesZ, AssetLoader& assets, bool keepCpuMesh) {
+    this->tilesX = tilesX;
+    this->tilesZ = tilesZ;
 
-    shaderProgram = CompileShader("shaders/tile.vert", "shaders/tile.frag");
+    assets.Submit("terrain mesh",
+        [this] {
+            std::vector<float> tileMesh = {
+                0.0f, 0.0f, 0.0f,
+                1.0f, 0.0f, 0.0f,
+                1.0f, 0.0f, 1.0f,
+                0.0f, 0.0f, 0.0f,
+                1.0f, 0.0f, 1.0f,
+                0.0f, 0.0f, 1.0f
+            };
+            terrainMesh = BuildTerrainMesh(tileMesh, this->tilesX, this->tilesZ);
+        },
+        [this, keepCpuMesh] {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &VBO);
+
+            BindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, terrainMesh.size() * sizeof(float), terrainMesh.data(), GL_STATIC_DRAW);
+
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+            BindVertexArray(0);
+
+            vertexCount = static_cast<GLsizei>(terrainMesh.size() / 8);
+            // heights come from GetTileHeight, so the CPU copy is only kept on request
+            if (!keepCpuMesh)
+                std::vector<float>().swap(terrainMesh);
+
+            // the cull pass reads the bounds and only ever changes instanceCount
+            if (gpuCulling) {
+                std::vector<glm::vec4> bounds;
+                std::vector<DrawArraysIndirectCommand> commands;
+                for (const Region& region : regions) {
+                    bounds.push_back(glm::vec4(region.center, region.radius));
+                    commands.push_back({ static_cast<GLuint>(region.count), 1, static_cast<GLuint>(region.first), 0 });
+                }
+                glGenBuffers(1, &regionBoundsBuffer);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, regionBoundsBuffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+                glGenBuffers(1, &regionCommandBuffer);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, regionCommandBuffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawArraysIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            }
+            if (useIndirect)
+                indirectBuffer.Init(GL_DRAW_INDIRECT_BUFFER, regions.size() * sizeof(DrawArraysIndirectCommand));
+
+            std::cout << "Terrain: " << vertexCount << " vertices in " << regions.size() << " regions"
+                << (useIndirect ? ", multi-draw indirect" : "") << (gpuCulling ? ", culled on the GPU" : "") << "\n";
+        });
+
+    // roughly each texture's average color until the 4K images are in; queued after the mesh,
+    // which has no placeholder
+    cliffTexture = assets.LoadTexture("textures/cliff_side_diff_4k.jpg", glm::vec4(0.42f, 0.39f, 0.35f, 1.0f));
+    grassTexture = assets.LoadTexture("textures/rocky_terrain_02_diff_4k.jpg", glm::vec4(0.40f, 0.38f, 0.30f, 1.0f));
+    riverbedTexture = assets.LoadTexture("textures/sandy_gravel_02_diff_4k.jpg", glm::vec4(0.52f, 0.47f, 0.40f, 1.0f));
+
+    // visible regions go out as one indirect draw where multi-draw indirect is supported
+    useIndirect = GetGLCaps().multiDrawIndirect;
+    gpuCulling = gpuCulling && useIndirect && GetGLCaps().computeShader;
+    if (gpuCulling)
+        cullShader.LoadCompute("shaders/cull_regions.comp");
+
+    shader.Load("shaders/tile.vert", "shaders/tile.frag");
+    shader.Use();
+    shader.SetMat4(UniformId("model"), glm::mat4(1.0f));
+    shader.SetFloat(UniformId("shininess"), 4.0f);
+    shader.SetInt(UniformId("cliffTex"), 0);
+    shader.SetInt(UniformId("shadowMap"), SHADOW_MAP_UNIT);
+    shader.SetInt(UniformId("grassTex"), 2);
+    shader.SetInt(UniformId("riverbedTex"), 3);
 }
 
-void Terrain::Render(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPos,
-    const glm::vec3& lightDir, const glm::vec3& lightColor, const glm::mat4& lightSpaceMatrix,
-    GLuint shadowMap, float sunElevation) {
+void Terrain::Submit(RenderQueue& queue, const Frustum& frustum) {
+    if (vertexCount == 0)
+        return;
+
+    // every uniform is constant and set in Init, samplers included
+    DrawPacket packet;
+    packet.program = &shader;
+    packet.vertexArray = VAO;
+    packet.AddTexture(0, GL_TEXTURE_2D, cliffTexture);
+    packet.AddTexture(2, GL_TEXTURE_2D, grassTexture);
+    packet.AddTexture(3, GL_TEXTURE_2D, riverbedTexture);
+    // the ground is under everything in view, so its packets sort as nearest and go down first
+
+    // one thread per region zeroes the instance count of those outside the frustum; the
+    // draw reads the commands after the barrier
+    if (gpuCulling && cullShader.IsReady()) {
+        cullShader.Use();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, regionBoundsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, regionCommandBuffer);
+        glDispatchCompute((static_cast<GLuint>(regions.size()) + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+        visibleRegions = -1;
+        packet.kind = DrawKind::MultiArraysIndirect;
+        packet.indirectBuffer = regionCommandBuffer;
+        packet.count = static_cast<GLsizei>(regions.size());
+        queue.Add(RenderPass::Opaque, packet);
+        return;
+    }
 
-    glUseProgram(shaderProgram);
+    std::vector<const Region*> visible;
+    for (const Region& region : regions) {
+        if (frustum.IsVisible(region.center, region.radius))
+            visible.push_back(&region);
+    }
+    visibleRegions = static_cast<int>(visible.size());
+    if (visible.empty())
+        return;
+
+    if (useIndirect) {
+        DrawArraysIndirectCommand* commands = static_cast<DrawArraysIndirectCommand*>(
+            indirectBuffer.Map(visible.size() * sizeof(DrawArraysIndirectCommand)));
+        for (size_t r = 0; r < visible.size(); r++)
+            commands[r] = { static_cast<GLuint>(visible[r]->count), 1, static_cast<GLuint>(visible[r]->first), 0 };
+        indirectBuffer.Unmap();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        packet.kind = DrawKind::MultiArraysIndirect;
+        packet.indirectBuffer = indirectBuffer.GetBuffer();
+        packet.indirectOffset = indirectBuffer.GetOffset();
+        packet.count = static_cast<GLsizei>(visible.size());
+        queue.Add(RenderPass::Opaque, packet);
+        return;
+    }
 
-    glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 mvp = projection * view * model;
+    // one draw per run of neighboring visible regions, which lie next to each other in the buffer
+    for (size_t r = 0; r < visible.size();) {
+        packet.first = visible[r]->first;
+        packet.count = 0;
+        do {
+            packet.count += visible[r]->count;
+            r++;
+        } while (r < visible.size() && visible[r]->first == packet.first + packet.count);
+        queue.Add(RenderPass::Opaque, packet);
+    }
+}
 
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "MVP"), 1, GL_FALSE, glm::value_ptr(mvp));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
+void Terrain::RequestTextureDetail(AssetLoader& assets, const glm::vec3& cameraPos, float pixelScale) {
+    // UV runs 0-1 across the world and tile.frag repeats each texture 24 times over it
+    const float textureRepeats = 24.0f;
 
-    glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(cameraPos));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightDir"), 1, glm::value_ptr(lightDir));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, glm::value_ptr(lightColor));
-    glUniform1f(glGetUniformLocation(shaderProgram, "sunElevation"), -sunElevation);
-    glUniform1f(glGetUniformLocation(shaderProgram, "shininess"), 4.0f);
+    // the closest terrain is about straight below the camera, where a pixel covers the least ground
+    float distance = glm::max(cameraPos.y - GetTileHeight(cameraPos.x, cameraPos.z), 1.0f);
+    float uvPerPixel = textureRepeats / tilesX * distance / pixelScale;
+    assets.RequestTextureDetail(cliffTexture, uvPerPixel);
+    assets.RequestTextureDetail(grassTexture, uvPerPixel);
+    assets.RequestTextureDetail(riverbedTexture, uvPerPixel);
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, cliffTexture);
-    glUniform1i(glGetUniformLocation(shaderProgram, "cliffTex"), 0);
+void Terrain::Cleanup() {
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays(1, &VAO);
+    shader.Cleanup();
+    glDeleteBuffers(1, &shadowVBO);
+    indirectBuffer.Cleanup();
+    glDeleteBuffers(1, &regionBoundsBuffer);
+    glDeleteBuffers(1, &regionCommandBuffer);
+    cullShader.Cleanup();
+}
 
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, grassTexture);
-    glUniform1i(glGetUniformLocation(shaderProgram, "grassTex"), 2);
+void Terrain::RegisterShadowCasters(ShadowPass& shadowPass) {
+    const int step = 5;           // world units per coarse quad
+    const int chunkSize = 50;     // world units per chunk side
+    const float sink = 1.0f;      // keep the coarse surface under the real one so it never self-shadows
+
+    struct Range { GLint first; GLsizei count; glm::vec3 minP, maxP; };
+    std::vector<Range> ranges;
+    std::vector<float> positions;
+    int quadsX = (tilesX + step - 1) / step, quadsZ = (tilesZ + step - 1) / step;
+    positions.reserve(static_cast<size_t>(quadsX) * quadsZ * 6 * 3);
+
+    for (int cz = 0; cz < tilesZ; cz += chunkSize) {
+        for (int cx = 0; cx < tilesX; cx += chunkSize) {
+            Range range;
+            range.first = static_cast<GLint>(positions.size() / 3);
+            range.minP = glm::vec3(1e9f);
+            range.maxP = glm::vec3(-1e9f);
+
+            for (int z = cz; z < cz + chunkSize && z < tilesZ; z += step) {
+                for (int x = cx; x < cx + chunkSize && x < tilesX; x += step) {
+                    int x1 = glm::min(x + step, tilesX);
+                    int z1 = glm::min(z + step, tilesZ);
+                    glm::vec3 corners[4] = {
+                        glm::vec3(x, 0.0f, z), glm::vec3(x1, 0.0f, z),
+                        glm::vec3(x1, 0.0f, z1), glm::vec3(x, 0.0f, z1)
+                    };
+                    for (auto& c : corners) {
+                        c.y = GetTileHeight(c.x, c.z) - 0.5f - sink;
+                        range.minP = glm::min(range.minP, c);
+                        range.maxP = glm::max(range.maxP, c);
+                    }
+
+                    const int order[6] = { 0, 1, 2, 0, 2, 3 };
+                    for (int i : order) {
+                        positions.push_back(corners[i].x);
+                        positions.push_back(corners[i].y);
+                        positions.push_back(corners[i].z);
+                    }
+                }
+            }
 
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, riverbedTexture);
-    glUniform1i(glGetUniformLocation(shaderProgram, "riverbedTex"), 3);
+            range.count = static_cast<GLsizei>(positions.size() / 3) - range.first;
+            ranges.push_back(range);
+        }
+    }
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, shadowMap);
-    glUniform1i(glGetUniformLocation(shaderProgram, "shadowMap"), 1);
+    glGenBuffers(1, &shadowVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, shadowVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
 
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, terrainMesh.size() / 8);
+    for (const auto& range : ranges) {
+        ShadowChunk chunk;
+        chunk.mesh = shadowPass.AddMesh(shadowVBO, 3 * sizeof(float), range.first, range.count);
+        chunk.center = (range.minP + range.maxP) * 0.5f;
+        chunk.radius = glm::length(range.maxP - range.minP) * 0.5f;
+        shadowChunks.push_back(chunk);
+    }
 }
 
-void Terrain::Cleanup() {
-    glDeleteTextures(1, &cliffTexture);
-    glDeleteTextures(1, &grassTexture);
-    glDeleteTextures(1, &riverbedTexture);
-    glDeleteBuffers(1, &VBO);
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteProgram(shaderProgram);
+void Terrain::SubmitShadowCasters(ShadowPass& shadowPass) const {
+    for (const auto& chunk : shadowChunks) {
+        if (shadowPass.IsVisible(chunk.center, chunk.radius))
+            shadowPass.AddInstance(chunk.mesh, glm::mat4(1.0f));
+    }
 }
 bool Terrain::RaycastToTerrain(const glm::vec3& origin, const glm::vec3& direction, glm::vec3& hitPoint) {
     float t = 0.0f;
@@ -137,44 +308,60 @@ float Terrain::GetTileHeight(float x, float z) {
 
 std::vector<float> Terrain::BuildTerrainMesh(const std::vector<float>& tileVerts, int tilesX, int tilesZ) {
     std::vector<float> terrainMesh;
-
-    for (int x = 0; x < tilesX; ++x) {
-        for (int z = 0; z < tilesZ; ++z) {
-            for (size_t i = 0; i < tileVerts.size(); i += 9) {
-                glm::vec3 p0(tileVerts[i], tileVerts[i + 1], tileVerts[i + 2]);
-                glm::vec3 p1(tileVerts[i + 3], tileVerts[i + 4], tileVerts[i + 5]);
-                glm::vec3 p2(tileVerts[i + 6], tileVerts[i + 7], tileVerts[i + 8]);
-
-                glm::vec3 worldP[3];
-                for (int j = 0; j < 3; ++j) {
-                    glm::vec3 lp = (j == 0 ? p0 : (j == 1 ? p1 : p2));
-                    float worldX = lp.x + x;
-                    float worldZ = lp.z + z;
-                    float height = GetTileHeight(worldX, worldZ);
-                    worldP[j] = glm::vec3(worldX, lp.y + height - 0.5f, worldZ);
-                }
-
-                glm::vec3 edge1 = worldP[1] - worldP[0];
-                glm::vec3 edge2 = worldP[2] - worldP[0];
-                glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
-
-
-                for (int j = 0; j < 3; ++j) {
-                    terrainMesh.push_back(worldP[j].x);
-                    terrainMesh.push_back(worldP[j].y);
-                    terrainMesh.push_back(worldP[j].z);
-                    terrainMesh.push_back(normal.x);
-                    terrainMesh.push_back(normal.y);
-                    terrainMesh.push_back(normal.z);
-                    float u = worldP[j].x / (float)tilesX;
-                    float v = worldP[j].z / (float)tilesZ;
-                    terrainMesh.push_back(u);
-                    terrainMesh.push_back(v);
+    terrainMesh.reserve(static_cast<size_t>(tilesX) * tilesZ * (tileVerts.size() / 3) * 8);
+    regions.clear();
+
+    for (int rz = 0; rz < tilesZ; rz += REGION_SIZE) {
+        for (int rx = 0; rx < tilesX; rx += REGION_SIZE) {
+            Region region;
+            region.first = static_cast<GLint>(terrainMesh.size() / 8);
+            glm::vec3 minP(1e9f), maxP(-1e9f);
+
+            for (int x = rx; x < rx + REGION_SIZE && x < tilesX; ++x) {
+                for (int z = rz; z < rz + REGION_SIZE && z < tilesZ; ++z) {
+                    for (size_t i = 0; i < tileVerts.size(); i += 9) {
+                        glm::vec3 p0(tileVerts[i], tileVerts[i + 1], tileVerts[i + 2]);
+                        glm::vec3 p1(tileVerts[i + 3], tileVerts[i + 4], tileVerts[i + 5]);
+                        glm::vec3 p2(tileVerts[i + 6], tileVerts[i + 7], tileVerts[i + 8]);
+
+                        glm::vec3 worldP[3];
+                        for (int j = 0; j < 3; ++j) {
+                            glm::vec3 lp = (j == 0 ? p0 : (j == 1 ? p1 : p2));
+                            float worldX = lp.x + x;
+                            float worldZ = lp.z + z;
+                            float height = GetTileHeight(worldX, worldZ);
+                            worldP[j] = glm::vec3(worldX, lp.y + height - 0.5f, worldZ);
+                            minP = glm::min(minP, worldP[j]);
+                            maxP = glm::max(maxP, worldP[j]);
+                        }
+
+                        glm::vec3 edge1 = worldP[1] - worldP[0];
+                        glm::vec3 edge2 = worldP[2] - worldP[0];
+                        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
+
+
+                        for (int j = 0; j < 3; ++j) {
+                            terrainMesh.push_back(worldP[j].x);
+                            terrainMesh.push_back(worldP[j].y);
+                            terrainMesh.push_back(worldP[j].z);
+                            terrainMesh.push_back(normal.x);
+                            terrainMesh.push_back(normal.y);
+                            terrainMesh.push_back(normal.z);
+                            float u = worldP[j].x / (float)tilesX;
+                            float v = worldP[j].z / (float)tilesZ;
+                            terrainMesh.push_back(u);
+                            terrainMesh.push_back(v);
+                        }
+                    }
                 }
             }
+
+            region.count = static_cast<GLsizei>(terrainMesh.size() / 8) - region.first;
+            region.center = (minP + maxP) * 0.5f;
+            region.radius = glm::length(maxP - minP) * 0.5f;
+            regions.push_back(region);
         }
     }
 
     return terrainMesh;
 }
-
@@ -2,23 +2,70 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <GL/gl3w.h>
+#include "shadow_pass.h"
+#include "asset_loader.h"
+#include "shader.h"
+#include "render_queue.h"
+#include "frustum.h"
+#include "stream_buffer.h"
 
 class Terrain {
 public:
-    void Init(int tilesX, int tilesZ);
-    void Render(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPos, const glm::vec3& lightDir,
-        const glm::vec3& lightColor, const glm::mat4& lightSpaceMatrix, GLuint shadowMap, float sunElevation);
+    // textures and the mesh load in the background; Submit adds nothing until the mesh is up
+    void Init(int tilesX, int tilesZ, AssetLoader& assets, bool keepCpuMesh = false);
+    // regions are culled by a compute pass instead of on the CPU; needs compute shaders and
+    // multi-draw indirect, set before Init
+    void SetGpuCulling(bool enabled) { gpuCulling = enabled; }
+    // queues the regions inside frustum; camera and sun come from the FrameData block,
+    // the shadow map from SHADOW_MAP_UNIT
+    void Submit(RenderQueue& queue, const Frustum& frustum);
+    int GetRegionCount() const { return static_cast<int>(regions.size()); }
+    // at the last Submit; -1 while the GPU culls
+    int GetVisibleRegionCount() const { return visibleRegions; }
+    // reports how sharp the textures need to be from cameraPos, for texture streaming
+    void RequestTextureDetail(AssetLoader& assets, const glm::vec3& cameraPos, float pixelScale);
     void Cleanup();
 
+    void RegisterShadowCasters(ShadowPass& shadowPass);
+    void SubmitShadowCasters(ShadowPass& shadowPass) const;
+
     float GetTileHeight(float x, float z);
+    // vertices ordered region by region; fills regions
     std::vector<float> BuildTerrainMesh(const std::vector<float>& tileVerts, int tilesX, int tilesZ);
     bool RaycastToTerrain(const glm::vec3& origin, const glm::vec3& direction, glm::vec3& hitPoint);
 
 
 private:
-    std::vector<float> terrainMesh;
+    std::vector<float> terrainMesh;     // only kept after upload with keepCpuMesh
+    GLsizei vertexCount = 0;
     GLuint VAO = 0, VBO = 0;
-    GLuint cliffTexture = 0, grassTexture = 0, riverbedTexture = 0;
-    GLuint shaderProgram = 0;
+
+    // the mesh is laid out region by region, so each region is one range of vertices and
+    // the visible ones are one multi-draw
+    struct Region {
+        GLint first;
+        GLsizei count;
+        glm::vec3 center;
+        float radius;
+    };
+    std::vector<Region> regions;
+    int visibleRegions = 0;
+    bool useIndirect = false;
+    StreamBuffer indirectBuffer;        // commands of the visible regions, written every frame
+    bool gpuCulling = false;
+    ShaderProgram cullShader;
+    GLuint regionBoundsBuffer = 0;      // center and radius per region, read by the cull pass
+    GLuint regionCommandBuffer = 0;     // a command per region, instance count set by the cull pass
+    GLuint cliffTexture = 0, grassTexture = 0, riverbedTexture = 0;     // owned by the asset loader
+    ShaderProgram shader;
     int tilesX = 0, tilesZ = 0;
+
+    // coarse position-only copy of the terrain used as a shadow caster, split into cullable chunks
+    struct ShadowChunk {
+        int mesh = -1;
+        glm::vec3 center;
+        float radius;
+    };
+    std::vector<ShadowChunk> shadowChunks;
+    GLuint shadowVBO = 0;
 };
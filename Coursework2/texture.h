@@ -5,32 +5,28 @@
 #include <GL/gl3w.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <string>
+#include <vector>
 
-GLuint LoadTexture(const char* path) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Load image
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = nrChannels == 4 ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        std::cout << "Loaded texture: " << path << " (" << width << "x" << height << ")\n";
-        stbi_image_free(data);
+// bilinear resize of an RGBA8 image, used to bring texture array layers to a common size
+inline std::vector<unsigned char> ResizeRGBA(const unsigned char* src, int srcW, int srcH, int dstW, int dstH) {
+    std::vector<unsigned char> dst(dstW * dstH * 4);
+    for (int y = 0; y < dstH; ++y) {
+        float sy = (y + 0.5f) * srcH / dstH - 0.5f;
+        int y0 = glm::clamp(int(glm::floor(sy)), 0, srcH - 1);
+        int y1 = glm::min(y0 + 1, srcH - 1);
+        float fy = glm::clamp(sy - y0, 0.0f, 1.0f);
+        for (int x = 0; x < dstW; ++x) {
+            float sx = (x + 0.5f) * srcW / dstW - 0.5f;
+            int x0 = glm::clamp(int(glm::floor(sx)), 0, srcW - 1);
+            int x1 = glm::min(x0 + 1, srcW - 1);
+            float fx = glm::clamp(sx - x0, 0.0f, 1.0f);
+            for (int c = 0; c < 4; ++c) {
+                float a = glm::mix(float(src[(y0 * srcW + x0) * 4 + c]), float(src[(y0 * srcW + x1) * 4 + c]), fx);
+                float b = glm::mix(float(src[(y1 * srcW + x0) * 4 + c]), float(src[(y1 * srcW + x1) * 4 + c]), fx);
+                dst[(y * dstW + x) * 4 + c] = static_cast<unsigned char>(glm::mix(a, b, fy) + 0.5f);
+            }
+        }
     }
-    else {
-        std::cerr << "Failed to load texture at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
\ No newline at end of file
+    return dst;
+}
@@ -0,0 +1,99 @@
+#include "texture_cache.h"
+#include "asset_pack.h"
+#include "stb_image.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+GLuint TextureCache::Find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = textures.find(NormalizeAssetName(key));
+    if (found == textures.end())
+        return 0;
+    textureHits++;
+    return found->second;
+}
+
+void TextureCache::Insert(const std::string& key, GLuint texture) {
+    std::lock_guard<std::mutex> lock(mutex);
+    textures[NormalizeAssetName(key)] = texture;
+}
+
+std::shared_ptr<const DecodedImage> TextureCache::Decode(const std::string& path, bool* reused) {
+    if (reused)
+        *reused = false;
+    std::shared_ptr<DecodeSlot> slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& entry = decodes[NormalizeAssetName(path)];
+        if (!entry)
+            entry = std::make_shared<DecodeSlot>();
+        slot = entry;
+    }
+
+    // a second request for the same file waits here for the first decode instead of repeating it
+    std::lock_guard<std::mutex> slotLock(slot->mutex);
+    if (auto image = slot->image.lock()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        decodeHits++;
+        if (reused)
+            *reused = true;
+        return image;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    // images with alpha are expanded to RGBA, everything else to 3 byte RGB
+    int width, height, channels;
+    if (!stbi_info(path.c_str(), &width, &height, &channels)) {
+        std::cerr << "Failed to load texture at path: " << path << std::endl;
+        return nullptr;
+    }
+    int wanted = GetDecodeChannels(channels);
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, wanted);
+    if (!data) {
+        std::cerr << "Failed to load texture at path: " << path << std::endl;
+        return nullptr;
+    }
+
+    auto image = std::make_shared<DecodedImage>();
+    image->texels = std::unique_ptr<unsigned char, void (*)(void*)>(data, stbi_image_free);
+    image->width = width;
+    image->height = height;
+    image->channels = wanted;
+    image->decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    // only held weakly, so the texels go as soon as the last upload using them is done
+    slot->image = image;
+    return image;
+}
+
+void TextureCache::Record(const TextureStats& entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.push_back(entry);
+}
+
+void TextureCache::PrintStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << "Textures (decode ms on workers, upload ms on the GL thread over frames, uploaded and VRAM MB):\n";
+    std::cout << std::fixed << std::setprecision(1);
+    size_t vramTotal = 0;
+    for (const auto& entry : stats) {
+        std::cout << "  " << std::setw(8) << entry.decodeMs << "  " << std::setw(8) << entry.uploadMs
+            << " /" << std::setw(3) << entry.uploadFrames << "  " << std::setw(6) << entry.bytes / (1024.0 * 1024.0)
+            << "  " << std::setw(6) << entry.vramBytes / (1024.0 * 1024.0) << "  " << entry.width << "x" << entry.height;
+        if (entry.layers > 1)
+            std::cout << "x" << entry.layers;
+        std::cout << " " << entry.format << "  " << entry.name << "\n";
+        vramTotal += entry.vramBytes;
+    }
+    std::cout << "  " << textures.size() << " textures, " << vramTotal / (1024.0 * 1024.0) << " MB VRAM, "
+        << textureHits << " repeated requests, " << decodeHits << " shared decodes\n";
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+void TextureCache::Cleanup() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : textures)
+        glDeleteTextures(1, &entry.second);
+    textures.clear();
+    decodes.clear();
+}
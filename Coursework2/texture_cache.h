@@ -0,0 +1,60 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/gl3w.h>
+
+// an image as stb_image decoded it, flipped for GL; shared by every request for the same file
+struct DecodedImage {
+    std::unique_ptr<unsigned char, void (*)(void*)> texels{ nullptr, nullptr };
+    int width = 0, height = 0;
+    int channels = 0;           // 3 for RGB files, 4 for everything else
+    double decodeMs = 0.0;
+
+    size_t GetSize() const { return size_t(width) * height * channels; }
+};
+
+// Textures by path. GL handles are handed out once per path (or list of paths for arrays)
+// and owned here until Cleanup, so callers must not delete them. Decodes are shared while
+// in flight: workers asking for a file another worker is decoding wait for that result.
+class TextureCache {
+public:
+    // GL thread; 0 when the key has not been loaded yet
+    GLuint Find(const std::string& key);
+    void Insert(const std::string& key, GLuint texture);
+
+    // any thread; nullptr when the file cannot be read. reused is set when another request
+    // already paid for the decode
+    std::shared_ptr<const DecodedImage> Decode(const std::string& path, bool* reused = nullptr);
+
+    // one row of the load report, recorded by the GL thread when the texture is complete
+    struct TextureStats {
+        std::string name;
+        std::string format;         // e.g. "BC1 .bctex", "RGB8"
+        int width = 0, height = 0, layers = 1;
+        size_t bytes = 0;           // uploaded through the unpack buffer
+        size_t vramBytes = 0;
+        double decodeMs = 0.0;      // worker time in stb_image, summed over layers
+        double uploadMs = 0.0;      // GL thread time staging and swapping in the texels
+        int uploadFrames = 0;
+    };
+    void Record(const TextureStats& stats);
+    void PrintStats() const;
+
+    void Cleanup();
+
+private:
+    struct DecodeSlot {
+        std::mutex mutex;
+        std::weak_ptr<DecodedImage> image;
+    };
+
+    std::unordered_map<std::string, GLuint> textures;
+    std::unordered_map<std::string, std::shared_ptr<DecodeSlot>> decodes;
+    std::vector<TextureStats> stats;
+    size_t textureHits = 0;
+    size_t decodeHits = 0;
+    mutable std::mutex mutex;
+};
@@ -0,0 +1,398 @@
+#include "texture_cook.h"
+#include "asset_pack.h"
+#include "gl_caps.h"
+#include "shader.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+const char COOKED_MAGIC[4] = { 'B', 'C', 'T', 'X' };
+const uint32_t COOKED_VERSION = 1;
+const size_t COOKED_ALIGNMENT = 64;
+
+struct CookedHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t glInternalFormat;  // what glCompressedTexImage2D is called with
+    uint32_t format;            // BlockFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t reserved;
+    int64_t sourceTime;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+};
+
+// offsets are from the start of the file
+struct CookedLevelRecord {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+std::string GetCookedPath(const std::string& imagePath) {
+    return imagePath + ".bctex";
+}
+
+bool GetSourceStamp(const std::string& path, int64_t& time, uint64_t& size) {
+    std::error_code ec;
+    time = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    if (ec)
+        return false;
+    size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    return !ec;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// uploads the uncompressed chain with a compressed internal format and reads back what
+// the driver encoded; GL thread
+bool CompressWithDriver(BlockFormat format, const unsigned char* chain, int width, int height, int channels,
+    std::vector<std::vector<unsigned char>>& levels) {
+    GLenum internalFormat = GetBlockInternalFormat(format);
+    std::vector<MipLevel> mips = GetMipLayout(width, height, channels);
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < mips.size(); level++) {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, mips[level].width, mips[level].height, 0,
+            channels == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, chain + mips[level].offset);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    bool ok = true;
+    levels.clear();
+    for (size_t level = 0; level < mips.size() && ok; level++) {
+        GLint compressed = GL_FALSE, actualFormat = 0, size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, static_cast<GLint>(level), GL_TEXTURE_COMPRESSED, &compressed);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, static_cast<GLint>(level), GL_TEXTURE_INTERNAL_FORMAT, &actualFormat);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, static_cast<GLint>(level), GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        // a driver may quietly keep the texels uncompressed; only its own blocks are worth keeping
+        if (!compressed || static_cast<GLenum>(actualFormat) != internalFormat
+            || static_cast<size_t>(size) != GetCompressedSize(mips[level].width, mips[level].height, format)) {
+            ok = false;
+            break;
+        }
+        levels.emplace_back(static_cast<size_t>(size));
+        glGetCompressedTexImage(GL_TEXTURE_2D, static_cast<GLint>(level), levels.back().data());
+    }
+    glDeleteTextures(1, &texture);
+    return ok && glGetError() == GL_NO_ERROR;
+}
+
+GLuint CreateCompressedTexture(BlockFormat format, int width, int height, const std::vector<std::vector<unsigned char>>& levels) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (size_t level = 0; level < levels.size(); level++) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GetBlockInternalFormat(format),
+            std::max(1, width >> level), std::max(1, height >> level), 0, static_cast<GLsizei>(levels[level].size()), levels[level].data());
+    }
+    return texture;
+}
+
+}
+
+bool CookedTexture::Open(const std::string& imagePath) {
+    Close();
+    int64_t sourceTime;
+    uint64_t sourceSize;
+    std::string cookedPath = GetCookedPath(imagePath);
+    if (!GetSourceStamp(imagePath, sourceTime, sourceSize) || !file.Open(cookedPath))
+        return false;
+
+    CookedHeader header;
+    if (file.GetSize() < sizeof(header)) {
+        Close();
+        return false;
+    }
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    if (std::memcmp(header.magic, COOKED_MAGIC, 4) != 0 || header.version != COOKED_VERSION
+        || header.sourceSize != sourceSize || header.levelCount == 0
+        || sizeof(header) + header.levelCount * sizeof(CookedLevelRecord) > file.GetSize()) {
+        Close();
+        return false;
+    }
+
+    // same size but touched: only a content hash mismatch invalidates the cook
+    if (header.sourceTime != sourceTime) {
+        uint64_t sourceHash = 0;
+        if (!HashFile(imagePath, sourceHash) || sourceHash != header.sourceHash) {
+            Close();
+            return false;
+        }
+
+        file.Close();
+        header.sourceTime = sourceTime;
+        std::fstream patch(cookedPath, std::ios::in | std::ios::out | std::ios::binary);
+        patch.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        patch.close();
+        if (!file.Open(cookedPath))
+            return false;
+    }
+
+    format = static_cast<BlockFormat>(header.format);
+    width = static_cast<int>(header.width);
+    height = static_cast<int>(header.height);
+    const unsigned char* records = file.GetData() + sizeof(header);
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        CookedLevelRecord record;
+        std::memcpy(&record, records + i * sizeof(record), sizeof(record));
+        if (record.offset + record.size > file.GetSize()
+            || record.size != GetCompressedSize(static_cast<int>(record.width), static_cast<int>(record.height), format)) {
+            Close();
+            return false;
+        }
+
+        CookedLevel level;
+        level.width = static_cast<int>(record.width);
+        level.height = static_cast<int>(record.height);
+        level.data = file.GetData() + record.offset;
+        level.size = static_cast<size_t>(record.size);
+        levels.push_back(level);
+    }
+    return true;
+}
+
+void CookedTexture::Close() {
+    file.Close();
+    levels.clear();
+    width = height = 0;
+}
+
+bool WriteCookedTexture(const std::string& imagePath, BlockFormat format, int width, int height,
+    const std::vector<std::vector<unsigned char>>& levels) {
+    CookedHeader header = {};
+    std::memcpy(header.magic, COOKED_MAGIC, 4);
+    header.version = COOKED_VERSION;
+    header.glInternalFormat = GetBlockInternalFormat(format);
+    header.format = static_cast<uint32_t>(format);
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    if (!GetSourceStamp(imagePath, header.sourceTime, header.sourceSize) || !HashFile(imagePath, header.sourceHash))
+        return false;
+
+    std::vector<CookedLevelRecord> records(levels.size());
+    uint64_t offset = sizeof(header) + records.size() * sizeof(CookedLevelRecord);
+    for (size_t level = 0; level < levels.size(); level++) {
+        offset = (offset + COOKED_ALIGNMENT - 1) & ~uint64_t(COOKED_ALIGNMENT - 1);
+        records[level].offset = offset;
+        records[level].size = levels[level].size();
+        records[level].width = static_cast<uint32_t>(std::max(1, width >> level));
+        records[level].height = static_cast<uint32_t>(std::max(1, height >> level));
+        offset += levels[level].size();
+    }
+
+    // write to a temporary name first so a half-written cook is never mapped
+    std::string cookedPath = GetCookedPath(imagePath);
+    std::string tempPath = cookedPath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CookedLevelRecord));
+        const char padding[COOKED_ALIGNMENT] = {};
+        for (size_t level = 0; level < levels.size(); level++) {
+            uint64_t pos = static_cast<uint64_t>(out.tellp());
+            out.write(padding, static_cast<std::streamsize>(records[level].offset - pos));
+            out.write(reinterpret_cast<const char*>(levels[level].data()), levels[level].size());
+        }
+        if (!out)
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cookedPath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool IsBlockFormatSupported(BlockFormat format) {
+    return format == BlockFormat::BC7 ? GetGLCaps().textureCompressionBPTC : GetGLCaps().textureCompressionS3TC;
+}
+
+void CookTextures(const std::string& directory, BlockFormat format) {
+    stbi_set_flip_vertically_on_load(true);
+
+    std::vector<std::string> images;
+    std::error_code ec;
+    for (const auto& item : std::filesystem::directory_iterator(directory, ec)) {
+        std::string extension = item.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".tga" || extension == ".bmp")
+            images.push_back(NormalizeAssetName(item.path().string()));
+    }
+    std::sort(images.begin(), images.end());
+
+    for (const auto& path : images) {
+        auto start = std::chrono::steady_clock::now();
+        int width, height, channels;
+        if (!stbi_info(path.c_str(), &width, &height, &channels)) {
+            std::cerr << "Failed to load texture at path: " << path << std::endl;
+            continue;
+        }
+        int wanted = GetDecodeChannels(channels);
+        // BC1 here is the opaque variant, cutouts would lose their alpha
+        if (format == BlockFormat::BC1 && wanted == 4) {
+            std::cout << "Cook: " << path << " skipped, it has alpha and BC1 is opaque only\n";
+            continue;
+        }
+
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, wanted);
+        if (!data) {
+            std::cerr << "Failed to load texture at path: " << path << std::endl;
+            continue;
+        }
+        std::vector<unsigned char> chain = BuildMipChain(data, width, height, wanted);
+        stbi_image_free(data);
+
+        BlockFormat cooked = format;
+        const char* encoder = "driver";
+        std::vector<std::vector<unsigned char>> levels;
+        if (!IsBlockFormatSupported(format) || !CompressWithDriver(format, chain.data(), width, height, wanted, levels)) {
+            if (wanted == 4) {
+                std::cout << "Cook: " << path << " skipped, no " << GetBlockFormatName(format) << " encoder for an image with alpha\n";
+                continue;
+            }
+            cooked = BlockFormat::BC1;
+            encoder = "CPU";
+            levels = CompressMipChainBC1(chain.data(), width, height, wanted);
+        }
+
+        size_t cookedSize = 0;
+        for (const auto& level : levels)
+            cookedSize += level.size();
+        if (!WriteCookedTexture(path, cooked, width, height, levels)) {
+            std::cerr << "Cook: could not write " << GetCookedPath(path) << "\n";
+            continue;
+        }
+        std::cout << "Cook: " << path << " " << GetBlockFormatName(cooked) << " (" << encoder << "), " << width << "x" << height
+            << ", " << levels.size() << " levels, " << chain.size() / (1024.0 * 1024.0) << " MB -> "
+            << cookedSize / (1024.0 * 1024.0) << " MB in " << MillisecondsSince(start) << " ms\n";
+    }
+}
+
+void RunTextureBandwidthBenchmark(const std::string& imagePath) {
+    const int TARGET_SIZE = 1024;
+    const int PASSES = 16;
+    const int TAPS = 4;
+
+    stbi_set_flip_vertically_on_load(true);
+    int width, height, channels;
+    if (!stbi_info(imagePath.c_str(), &width, &height, &channels)) {
+        std::cerr << "Failed to load texture at path: " << imagePath << std::endl;
+        return;
+    }
+    int wanted = GetDecodeChannels(channels);
+    unsigned char* data = stbi_load(imagePath.c_str(), &width, &height, &channels, wanted);
+    if (!data) {
+        std::cerr << "Failed to load texture at path: " << imagePath << std::endl;
+        return;
+    }
+    std::vector<unsigned char> chain = BuildMipChain(data, width, height, wanted);
+    stbi_image_free(data);
+    std::vector<MipLevel> mips = GetMipLayout(width, height, wanted);
+
+    struct Variant {
+        std::string name;
+        GLuint texture;
+        int bitsPerTexel;
+    };
+    std::vector<Variant> variants;
+
+    GLuint raw;
+    glGenTextures(1, &raw);
+    glBindTexture(GL_TEXTURE_2D, raw);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < mips.size(); level++) {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), wanted == 3 ? GL_RGB8 : GL_RGBA8, mips[level].width, mips[level].height, 0,
+            wanted == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, chain.data() + mips[level].offset);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    variants.push_back({ wanted == 3 ? "RGB8" : "RGBA8", raw, wanted * 8 });
+
+    if (IsBlockFormatSupported(BlockFormat::BC1)) {
+        auto levels = CompressMipChainBC1(chain.data(), width, height, wanted);
+        variants.push_back({ "BC1", CreateCompressedTexture(BlockFormat::BC1, width, height, levels), 4 });
+    }
+    std::vector<std::vector<unsigned char>> bc7;
+    if (IsBlockFormatSupported(BlockFormat::BC7) && CompressWithDriver(BlockFormat::BC7, chain.data(), width, height, wanted, bc7))
+        variants.push_back({ "BC7", CreateCompressedTexture(BlockFormat::BC7, width, height, bc7), 8 });
+
+    GLuint target, framebuffer, vao;
+    glGenTextures(1, &target);
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TARGET_SIZE, TARGET_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    glGenVertexArrays(1, &vao);
+
+    ShaderProgram shader;
+    shader.Load("shaders/texture_bench.vert", "shaders/texture_bench.frag");
+    shader.WaitUntilReady();
+    shader.Use();
+    shader.SetInt(UniformId("image"), 0);
+    glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glBindVertexArray(vao);
+
+    std::cout << "Texture bandwidth: " << imagePath << " " << width << "x" << height << ", " << TARGET_SIZE << "x" << TARGET_SIZE
+        << " target, " << TAPS << " taps per pixel, " << PASSES << " passes\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& variant : variants) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, variant.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        for (int lod : { 0, 2 }) {
+            shader.SetFloat(UniformId("lod"), static_cast<float>(lod));
+            shader.SetVec2(UniformId("scale"), glm::vec2(float(TARGET_SIZE) / std::max(1, width >> lod),
+                float(TARGET_SIZE) / std::max(1, height >> lod)));
+            // one untimed pass so first-use costs stay out of the numbers
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glFinish();
+
+            // wall time to glFinish rather than a timer query: software rasterizers defer the
+            // work past the query, and here nothing else is running to hide behind
+            auto start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < PASSES; pass++)
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            glFinish();
+            double msPerPass = MillisecondsSince(start) / PASSES;
+            double samples = double(TARGET_SIZE) * TARGET_SIZE * TAPS;
+            double samplesPerSecond = samples / (msPerPass / 1000.0);
+            std::cout << "  " << std::setw(5) << variant.name << " lod " << lod << ": " << std::setw(8) << msPerPass << " ms/pass, "
+                << std::setw(6) << samplesPerSecond / 1e9 << " Gsamples/s, " << std::setw(7)
+                << samplesPerSecond * variant.bitsPerTexel / 8.0 / 1e9 << " GB/s of texel data at "
+                << variant.bitsPerTexel << " bits/texel\n";
+        }
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &target);
+    glDeleteVertexArrays(1, &vao);
+    shader.Cleanup();
+    for (const auto& variant : variants)
+        glDeleteTextures(1, &variant.texture);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "block_compress.h"
+#include "mapped_file.h"
+
+// "<image>.bctex" sits next to its source image like a .meshcache beside an OBJ. It is
+// KTX-like: a header naming the block format and the source it was cooked from, a level
+// table, then the compressed mip chain down to 1x1, each level 64 byte aligned.
+
+struct CookedLevel {
+    int width = 0;
+    int height = 0;
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+class CookedTexture {
+public:
+    // maps the image's sidecar if it was cooked from the image as it is on disk now
+    bool Open(const std::string& imagePath);
+    void Close();
+
+    BlockFormat GetFormat() const { return format; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    const std::vector<CookedLevel>& GetLevels() const { return levels; }
+
+private:
+    MappedFile file;
+    BlockFormat format = BlockFormat::BC1;
+    int width = 0, height = 0;
+    std::vector<CookedLevel> levels;
+};
+
+// writes the sidecar for levels (largest first), tagged with the image's size, time and hash
+bool WriteCookedTexture(const std::string& imagePath, BlockFormat format, int width, int height,
+    const std::vector<std::vector<unsigned char>>& levels);
+
+// whether the context can sample the format: BC1 needs S3TC, BC7 needs BPTC
+bool IsBlockFormatSupported(BlockFormat format);
+
+// --cook-textures: cooks every image in directory on the GL thread, through the driver's
+// encoder when it has one for format and the CPU BC1 encoder otherwise
+void CookTextures(const std::string& directory, BlockFormat format);
+
+// --bench-textures: fragment sampling rate of one image as RGB8, BC1 and BC7
+void RunTextureBandwidthBenchmark(const std::string& imagePath);
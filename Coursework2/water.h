@@ -4,15 +4,19 @@
 #include <gl3w.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "shader.h"
+#include "render_queue.h"
 
 class Water {
 public:
     static void Init(float worldSize, float waterHeight);
-    static void Render(const glm::mat4& projection, const glm::mat4& view, float sunElevation);
+    // camera, sun and time come from the FrameData block
+    static void Submit(RenderQueue& queue);
     static void Cleanup();
 
 private:
-    static GLuint VAO, VBO, shaderProgram, mvpLocation;
+    static GLuint VAO, VBO;
+    static ShaderProgram shader;
     static float height;
 };
 